@@ -17,6 +17,8 @@
 #include <assert.h>
 #include <limits.h>
 #include <time.h>
+#include <errno.h>
+#include <locale.h>
 
 #if defined( _WIN32 ) || defined( _WIN64 )
    #include <direct.h>
@@ -35,6 +37,23 @@
    #include <sys/stat.h>
    #include <unistd.h>
 
+   #if defined( __linux__ )
+      #include <fcntl.h>
+      #include <poll.h>
+      #include <sys/inotify.h>
+      #include <sys/syscall.h>
+
+      #if defined( __NR_io_uring_setup ) && defined( __has_include )
+         #if __has_include( <linux/io_uring.h> )
+            #include <sys/mman.h>
+            #include <linux/io_uring.h>
+            #include <linux/stat.h>
+
+            #define HC_HAVE_URING
+         #endif
+      #endif
+   #endif
+
    #define GET_CURRENT_DIR  getcwd
    #define PATH_MAX         4096  /* # chars in a path name including nul */
    #define PS               "/"
@@ -80,6 +99,25 @@
 
 #define WAIT_TIME_SECONDS   10
 
+#define LISTING_INITIAL     256   /* first capacity of a Listing, doubled on every growth */
+#define NAMES_INITIAL       4096  /* first size of the name pool of a Listing, doubled on every growth */
+#define ROW_CACHE           512   /* formatted rows a panel keeps, more than fit on any screen */
+#define FRAME_ARENA_INITIAL 16384 /* first block of the per-frame string arena, doubled when a frame needs more */
+#define GETDENTS_BUFFER     ( 256 * 1024 )  /* bytes of directory entries fetched per getdents64 call */
+#define INFO_PREFETCH       64    /* rows stat'ed ahead of and behind the visible ones in lazy mode */
+#define POOL_MAX_THREADS    64    /* upper bound of worker threads, including the caller */
+#define STAT_CHUNK          32    /* entries a stat worker claims at a time */
+#define WIDTH_MAX           512   /* name widths counted one by one, longer names count as this */
+#define RADIX_THRESHOLD     4096  /* entries from which the name sort uses multikey quicksort, see HC_RADIX_THRESHOLD */
+#define RADIX_INSERTION     16    /* keys the multikey quicksort leaves to insertion sort */
+#define SORT_PARALLEL       100000 /* entries from which a sort is split over the worker pool, see HC_SORT_THREADS */
+#define URING_DEPTH         256   /* statx requests kept in flight by the io_uring backend */
+#define STREAM_BATCH        4096  /* entries between progress reports of readdir style enumerations */
+#define STREAM_INTERVAL     100   /* ms between two partial listings handed to the panel */
+#define WATCH_MAX           16    /* directories watched at the same time */
+#define WATCH_BUFFER        ( 64 * 1024 )  /* bytes of inotify events read per call */
+#define WATCH_INTERVAL      20    /* ms the watcher sleeps while the panel has not drained its events */
+
 enum nk_bool
 {
    F = 0,
@@ -87,16 +125,420 @@ enum nk_bool
 };
 
 typedef struct _HC      HC;
-typedef struct _DirList DirList;
+typedef struct _Listing Listing;
+typedef struct _WorkerPool WorkerPool;
+typedef struct _StatJob StatJob;
+typedef struct _SortJob SortJob;
+typedef struct _URing URing;
+typedef struct _FetchSlot FetchSlot;
+typedef struct _FetchRequest FetchRequest;
+typedef struct _SortRequest SortRequest;
+typedef struct _CacheEntry CacheEntry;
+typedef struct _ListingCache ListingCache;
+typedef struct _FileWatch FileWatch;
+typedef struct _TimeFormat TimeFormat;
+typedef struct _SortKey SortKey;
+typedef struct _Collation Collation;
+typedef struct _WatchChange WatchChange;
+typedef struct _ArenaBlock ArenaBlock;
+typedef struct _RowLayout RowLayout;
+typedef struct _RowFormat RowFormat;
+typedef struct _CachedRow CachedRow;
+typedef struct _BoxCache BoxCache;
+typedef struct _Cell Cell;
+typedef struct _CellGrid CellGrid;
+
+/* Called by hc_directory after each batch of entries; returning F abandons the listing, which
+   hc_directory then frees and reports as NULL without stat'ing or sorting what it read */
+typedef nk_bool ( *ListingProgress )( Listing *listing, void *userData );
+
+/* How entries are stat'ed, chosen at run time through HC_STAT_BACKEND */
+enum
+{
+   STAT_BACKEND_SYNC  = 0,   /* fstatat / stat, on the worker pool when configured */
+   STAT_BACKEND_URING = 1    /* batched IORING_OP_STATX, falls back to sync */
+};
+
+/* Flag bits of a listing entry; the first four make up the attr column, in this order */
+enum
+{
+   DIRLIST_ARCHIVE    = 0x01,   /* "A", regular file */
+   DIRLIST_EXECUTABLE = 0x02,   /* "E" */
+   DIRLIST_DIRECTORY  = 0x04,   /* "D" */
+   DIRLIST_HIDDEN     = 0x08,   /* "H" */
+   DIRLIST_STATED     = 0x10,   /* size, mtime and mode hold the result of a stat */
+   DIRLIST_LOADED     = 0x20,   /* no stat pending any more, even when it failed */
+   DIRLIST_SELECTED   = 0x40    /* marked by the user */
+};
+
+#define DIRLIST_ATTR ( DIRLIST_ARCHIVE | DIRLIST_EXECUTABLE | DIRLIST_DIRECTORY | DIRLIST_HIDDEN )
+
+/* Groups of the name sort, in display order */
+enum
+{
+   SORT_RANK_PARENT           = 0,   /* ".." */
+   SORT_RANK_DIRECTORY        = 1,
+   SORT_RANK_HIDDEN_DIRECTORY = 2,
+   SORT_RANK_FILE             = 3,
+   SORT_RANK_HIDDEN_FILE      = 4
+};
+
+/* Orders a panel can show a listing in, picked with Ctrl+F3 .. Ctrl+F9. Every mode keeps the
+   groups of the name sort and orders the entries inside a group by its own field. */
+enum
+{
+   SORT_NAME      = 0,
+   SORT_EXTENSION = 1,   /* files only, directories stay by name */
+   SORT_TIME      = 2,   /* newest first */
+   SORT_SIZE      = 3,   /* largest first, files only */
+   SORT_UNSORTED  = 4,   /* read order with ".." first, no sort at all */
+   SORT_NATURAL   = 5,   /* name with digit runs compared by value, frame_2 before frame_10 */
+   SORT_LOCALE    = 6,   /* name in the LC_COLLATE order of the user's locale */
+   SORT_MODES     = 7
+};
+
+/* What a sort compares, computed once per entry before sorting: the group first, then the
+   leading bytes of the sort field; only equal prefixes fall back to comparing strings */
+struct _SortKey
+{
+   uint64_t  prefix;   /* sort field, big endian, names and extensions zero padded to 8 bytes */
+   uint32_t  index;    /* entry */
+   uint8_t   rank;     /* SORT_RANK_* */
+   uint8_t   named;    /* prefix holds the start of the name */
+};
+
+/* Sort keys derived from the names for one SORT_* mode, computed once per entry and packed
+   into a pool like the names: the key of entry i is keys + offset[ i ] */
+struct _Collation
+{
+   char     *keys;
+   uint32_t  size;
+   uint32_t  capacity;
+   uint32_t *offset;     /* NULL while the mode has no keys */
+};
+
+/* One directory listing, stored column-wise: entry i is names + nameOffset[ i ], size[ i ], ...
+   Names are packed once into a pool. Entries keep the order the directory was read in; panels
+   show them through one of `orders`, each mapping a position on screen to an entry for one
+   SORT_* mode. Permutations are built on a loader thread the first time a mode is asked for
+   and then kept up to date until the listing is freed. Columns and pool grow
+   geometrically and the whole listing is released with hc_listingFree. Listings handed to panels
+   are reference counted and may be shared through the listing cache. */
+struct _Listing
+{
+   char     *names;        /* name pool, every name NUL terminated */
+   uint32_t  namesSize;
+   uint32_t  namesCapacity;
+
+   uint32_t *nameOffset;
+   int64_t  *size;
+   int64_t  *mtime;        /* seconds since the epoch */
+   uint32_t *mode;         /* st_mode, 0 on Windows */
+   uint8_t  *flags;        /* DIRLIST_* */
+   uint32_t *orders[ SORT_MODES ];   /* entry shown at each position, NULL until the mode is used;
+                                       SORT_UNSORTED always exists */
+
+   Collation collations[ SORT_MODES ];   /* keys of SORT_NATURAL and SORT_LOCALE, built with their order */
+   int       count;
+   int       capacity;
+   int       allocCount;   /* heap allocations made while building */
+
+   char      path[ PATH_MAX ];
+   int       dirFd;        /* kept open for lazy stats on Linux, - 1 otherwise */
+   int       statThreads;  /* workers used to stat entries of this directory */
+   int       statBackend;  /* STAT_BACKEND_* */
+
+   int         refCount;     /* guarded by the listing cache mutex */
+   CacheEntry *cacheEntry;   /* NULL when the listing is private */
+
+   nk_bool   sorted;       /* complete, modes other than SORT_UNSORTED are sorted in the background on demand */
+   nk_bool   measured;     /* the width counts below are valid and kept up to date */
+   int       nameWidths[ WIDTH_MAX + 1 ];   /* entries per width of each column in characters */
+   int       sizeWidths[ 21 ];
+   int       attrWidths[ 5 ];
+   int       watch;        /* inotify watch descriptor once shown in a panel, - 1 otherwise */
+   uint32_t  serial;       /* unique per listing, tells apart a new listing at a freed one's address */
+   uint32_t  version;      /* bumped whenever entries are added, removed or change their columns */
+   uint32_t  edits;        /* bumped when entries are added, removed or stat'ed again, not when first loaded */
+};
+
+/* Hand-over point between a panel and its background loaders. A loader publishes a finished
+   listing by swapping `ready` together with its generation; the panel keeps it only when that
+   generation is still current. */
+struct _FetchSlot
+{
+   SDL_atomic_t  refCount;          /* the panel plus every loader still running */
+   SDL_atomic_t  generation;        /* bumped by every hc_fetchList */
+   SDL_mutex    *publishMutex;      /* guards the fields below */
+   Listing      *ready;             /* taken by hc_pollFetchList */
+   int           readyGeneration;
+   Listing      *partial;           /* entries read since the panel last looked, in readdir order */
+   int           partialGeneration;
+   SortRequest  *sorted;            /* finished background sorts, taken by hc_pollFetchList */
+   SDL_atomic_t  progress;          /* entries read so far by the current loader */
+};
+
+struct _FetchRequest
+{
+   FetchSlot *slot;
+   int        generation;
+   char       path[ PATH_MAX ];
+   nk_bool    lazyInfo;
+   nk_bool    sortList;
+   int        sortMode;        /* SORT_* sorted on the loader thread */
+
+   int        published;       /* entries already handed over as partial listings */
+   Uint32     lastPublish;
+   nk_bool    cancelled;       /* enumeration abandoned or failed, an empty listing is handed over */
+};
+
+/* A SORT_* order built on a loader thread from a copy of the listing a panel shows, so the
+   sort and the stats it needs never hold up the UI. The panel takes the order over only when
+   the listing did not change in between. */
+struct _SortRequest
+{
+   FetchSlot *slot;
+   int        generation;      /* of the fetch the listing came from */
+   Listing   *listing;         /* the copy, sorted and stat'ed by the loader */
+   int        mode;
+   uint32_t   serial;          /* of the listing copied */
+   uint32_t   edits;           /* its edits when copied */
+   SortRequest *next;          /* finished earlier, not taken yet */
+};
+
+/* Options a cached listing was built with; listings only match requests with the same ones */
+enum
+{
+   LISTING_LAZY   = 1,
+   LISTING_SORTED = 2
+};
+
+/* A directory listing shared by every panel showing the same directory state.
+   `listing` stays NULL while the first loader builds it; later loaders wait for it. */
+struct _CacheEntry
+{
+   char         path[ PATH_MAX ];
+   uint64_t     dev;
+   uint64_t     ino;
+   int64_t      mtimeSec;
+   long         mtimeNsec;
+   int          options;
+   Listing     *listing;
+   nk_bool      removed;   /* unlinked; the last waiter frees it */
+   int          waiters;
+   CacheEntry  *next;
+};
+
+struct _ListingCache
+{
+   SDL_mutex   *mutex;
+   SDL_cond    *loaded;
+   CacheEntry  *entries;
+};
+
+/* Threads that run one job at a time; the thread calling hc_poolRun always takes part */
+struct _WorkerPool
+{
+   SDL_mutex  *runMutex;   /* held by the caller whose job the workers run */
+   SDL_mutex  *mutex;
+   SDL_cond   *wake;
+   SDL_cond   *done;
+   SDL_Thread *threads[ POOL_MAX_THREADS ];
+   int         threadCount;
+
+   void      ( *job )( void *arg );
+   void       *arg;
+   int         pending;    /* workers that still have to pick up the job */
+   int         running;    /* workers that have not finished it yet */
+   nk_bool     quit;
+};
+
+#if defined( HC_HAVE_URING )
+/* Submission and completion rings shared with the kernel */
+struct _URing
+{
+   int                   ringFd;
+   void                 *sqRing;
+   void                 *cqRing;
+   size_t                sqRingSize;
+   size_t                cqRingSize;
+   struct io_uring_sqe  *sqes;
+   size_t                sqesSize;
+
+   unsigned             *sqHead;
+   unsigned             *sqTail;
+   unsigned             *sqMask;
+   unsigned             *sqArray;
+   unsigned             *cqHead;
+   unsigned             *cqTail;
+   unsigned             *cqMask;
+   struct io_uring_cqe  *cqes;
+};
+#endif
+
+/* Entries in [ first, last ) of a listing, handed out to workers STAT_CHUNK at a time */
+struct _StatJob
+{
+   Listing        *listing;
+   const uint32_t *order;
+   int             first;
+   int             last;
+   SDL_atomic_t    next;
+};
+
+/* A sort split over the worker pool: every worker builds and sorts runs of keys, then pairs
+   of runs are merged in rounds until one is left */
+struct _SortJob
+{
+   const Listing  *listing;
+   int             mode;
+   nk_bool         radix;                            /* runs are sorted by hc_sortKeysByName */
+   SortKey        *keys;                             /* holds the runs */
+   SortKey        *temp;                             /* receives the merged runs */
+   int             count;
+   int             runs;
+   int             bounds[ POOL_MAX_THREADS + 1 ];   /* run r is keys[ bounds[ r ] .. bounds[ r + 1 ] ) */
+   nk_bool         merging;
+   SDL_atomic_t    next;                             /* run or pair of runs claimed next */
+};
+
+#if defined( __linux__ )
+/* Directories shown in the panels, watched through one inotify descriptor. The kernel hands out
+   one watch descriptor per directory, so listings of the same directory share it. */
+struct _FileWatch
+{
+   int           fd;
+   SDL_mutex    *mutex;                    /* guards the table below */
+   int           wds[ WATCH_MAX ];
+   int           users[ WATCH_MAX ];       /* listings using wds[ i ] */
+   SDL_atomic_t  pending;                  /* events are waiting for hc_watchPoll */
+};
+
+/* One entry to refresh, coalesced over all events read in a frame */
+struct _WatchChange
+{
+   int   wd;
+   char  name[ NAME_MAX + 1 ];
+};
+
+/* Record layout returned by the getdents64 system call */
+struct _LinuxDirent64
+{
+   uint64_t       d_ino;
+   int64_t        d_off;
+   unsigned short d_reclen;
+   unsigned char  d_type;
+   char           d_name[];
+};
+#endif
+
+/* The calendar day a timestamp formatter saw last. Each caller owns one, so worker threads can
+   format concurrently; times inside the day are derived without another localtime_r. */
+struct _TimeFormat
+{
+   int64_t  dayStart;     /* first second of the day, local time */
+   int64_t  dayEnd;       /* first second after it; equal to dayStart when nothing is cached */
+   char     date[ 11 ];   /* "%d-%m-%Y" of that day */
+};
+
+/* Memory of the string helpers while a frame is drawn. Allocations only bump `used` and are
+   dropped together by hc_frameReset at the start of the next frame. A frame that needs more
+   chains a block twice as large; the reset keeps only that one, so after a few frames drawing
+   does not touch the heap. */
+struct _ArenaBlock
+{
+   ArenaBlock *previous;   /* smaller blocks still in use by the current frame */
+   size_t      capacity;
+   size_t      used;
+   char        data[];
+};
+
+/* Everything the text of a row depends on besides its entry. A panel compares it every frame
+   and bumps its row version when anything differs, which drops all cached rows at once. */
+struct _RowLayout
+{
+   uint32_t  listingSerial;
+   uint32_t  listingVersion;
+   int       maxCol;
+   int       longestName;
+   int       longestSize;
+   int       longestAttr;
+   nk_bool   sizeVisible;
+   nk_bool   attrVisible;
+   nk_bool   dateVisible;
+   nk_bool   timeVisible;
+};
+
+enum
+{
+   ROW_SIZE = 0,
+   ROW_ATTR = 1,
+   ROW_DATE = 2,
+   ROW_TIME = 3
+};
+
+/* Column layout of the rows of a panel, compiled from the RowLayout whenever it changes. A row
+   is the name cut or padded to nameWidth followed by the info columns right aligned in
+   infoWidth; ".." shows as "[..]" followed by the info columns in parentWidth. The info columns
+   are the visible ones joined by a space, size and attr right aligned in their column width. */
+struct _RowFormat
+{
+   int       width;             /* characters of a row, maxCol - 2 */
+   int       nameWidth;
+   int       infoWidth;         /* 0 or less when only the name fits */
+   int       parentWidth;
+   int       infoLimit;         /* bytes the joined info columns are cut to */
+   int       columns;           /* visible info columns, none shows a single space */
+   uint8_t   column[ 4 ];       /* ROW_* from left to right */
+   int       columnWidth[ 4 ];  /* - 1 for date and time, which are copied as they are */
+};
+
+/* Formatted text of the row shown at a position, kept while the entry there and the layout stay the same */
+struct _CachedRow
+{
+   int       entry;
+   uint32_t  version;    /* row version of the panel the text was built for */
+   char     *text;       /* NULL until first used, then reused for every row cached here */
+   size_t    capacity;
+};
 
-struct _DirList
+/* Border of a panel as it is drawn: each horizontal edge one string with its corners, the
+   vertical edges one glyph repeated down both sides. Built when the box changes width or
+   style; every frame only replays it. */
+struct _BoxCache
 {
-   char name[ 512 ];
-   char size[ 20 ];
-   char date[ 11 ];
-   char time[ 9 ];
-   char attr[ 6 ];
-   nk_bool state;
+   int             width;
+   const char     *boxString;    /* BOX_* the edges were built from, NULL until built */
+   char           *top;
+   char           *bottom;
+   size_t          capacity;     /* bytes of top and of bottom */
+   uint32_t        vertical;     /* code point of both vertical edges */
+};
+
+/* One character cell of the screen */
+struct _Cell
+{
+   uint32_t        codepoint;
+   struct nk_color fg;
+   struct nk_color bg;
+};
+
+/* The panels as a text screen of cols x rows cells. hc_drawText and hc_drawBox only write
+   cells; hc_gridFlush compares them with the cells the target texture already shows and turns
+   just the changed runs into draw commands. The target keeps its pixels between frames, so a
+   still frame draws no cell at all and moving the bar redraws two rows. */
+struct _CellGrid
+{
+   int             cols;
+   int             rows;
+   Cell           *cells;     /* written this frame */
+   Cell           *shown;     /* drawn into the target */
+   struct nk_rect  origin;    /* pixel rectangle of cell 0, 0 the grid was laid out for */
+   SDL_Texture    *target;    /* NULL when the renderer cannot draw to textures, every frame is then drawn in full */
+   int             width;     /* pixels of the target */
+   int             height;
+   nk_bool         full;      /* the target lost its cells, all of them are drawn again */
+   nk_bool         flushed;   /* the cells of this frame were turned into commands */
 };
 
 struct _HC
@@ -107,8 +549,7 @@ struct _HC
    int       maxRow;
 
    char      currentDir[ PATH_MAX ];
-   DirList  *dirList;
-   int       itemCount;
+   Listing  *listing;
 
    int       rowBar;
    int       rowNo;
@@ -126,28 +567,153 @@ struct _HC
    nk_bool   attrVisible;
    nk_bool   dateVisible;
    nk_bool   timeVisible;
+
+   nk_bool   lazyInfo;     /* list names only, stat the rows as they are drawn */
+   int       sortMode;     /* SORT_* shown, its order exists */
+   int       pendingSort;  /* SORT_* sorted in the background to be shown next, - 1 when none */
+   TimeFormat timeFormat;  /* day of the timestamps drawn last */
+   RowLayout rowLayout;    /* layout the cached rows were built for */
+   RowFormat rowFormat;    /* compiled from rowLayout */
+   uint32_t  rowVersion;
+   CachedRow rows[ ROW_CACHE ];   /* row at listing position i is cached in rows[ i % ROW_CACHE ] */
+   BoxCache  box;
+
+   FetchSlot *fetchSlot;
+   nk_bool   loading;      /* a fetch is in progress, the listing is a placeholder */
+   char      selectName[ PATH_MAX ];   /* entry to put the bar on once the fetch arrives */
 };
 
 static HC         *hc_init( void );
 static void        hc_free( HC *selectedPanel );
 static void        hc_printInfo( const HC *selectedPanel );
 static void        hc_fetchList( HC *selectedPanel, const char *currentDir );
-static int         hc_compareDirList( const void *A, const void *B );
+static int         hc_fetchWorker( void *data );
+static nk_bool     hc_fetchProgress( Listing *listing, void *userData );
+static void        hc_wakeEventLoop( void );
+static void        hc_pollFetchList( HC *selectedPanel );
+static void        hc_fetchSlotRelease( FetchSlot *slot );
+static void        hc_fetchSort( HC *selectedPanel, int mode );
+static int         hc_sortWorker( void *data );
+static void        hc_pollSort( HC *selectedPanel, SortRequest *request );
+static void        hc_selectName( HC *selectedPanel, const char *name );
+static void        hc_setSortMode( HC *selectedPanel, int mode );
+static int         hc_compareEntries( const char *nameA, int flagsA, const char *nameB, int flagsB );
 static const char *hc_cwd( void );
 static const char *hc_defaultValueChar( const char *A, const char *B );
 static void        hc_strncpy( char oldValue[ PATH_MAX ], const char *newValue );
-static DirList    *hc_directory( const char *currentDir, int *size );
+static Listing    *hc_directory( const char *currentDir, nk_bool lazyInfo, ListingProgress progress, void *userData );
+static Listing    *hc_listingNew( void );
+static Listing    *hc_listingCopy( const Listing *source );
+static nk_bool     hc_listingAdopt( Listing *listing, Listing *sorted, int mode );
+static const char *hc_listingName( const Listing *listing, int entry );
+static const uint32_t *hc_listingOrder( Listing *listing, int mode );
+static int         hc_listingEntry( Listing *listing, int mode, int position );
+static const char *hc_listingNameAt( Listing *listing, int mode, int position );
+static int         hc_listingPosition( Listing *listing, int mode, int entry );
+static int         hc_listingAppend( Listing *listing, const char *name );
+static nk_bool     hc_listingAppendFrom( Listing *listing, const Listing *source, int first, int count, nk_bool skipParent );
+static void        hc_listingMove( uint32_t *order, int from, int to );
+static void        hc_listingRemove( Listing *listing, int entry );
+static void        hc_listingSort( Listing *listing, int mode );
+static const char *hc_nameExtension( const char *name );
+static nk_bool     hc_sortCollated( int mode );
+static size_t      hc_collationKey( int mode, const char *name, char *key, size_t room );
+static nk_bool     hc_listingCollate( Listing *listing, int mode, int entry );
+static nk_bool     hc_listingCollateAll( Listing *listing, int mode );
+static void        hc_collationDrop( Listing *listing, int mode );
+static const char *hc_sortField( const Listing *listing, int mode, int entry );
+static void        hc_sortKeyMake( const Listing *listing, int mode, int entry, SortKey *key );
+static int         hc_sortKeyCompare( const Listing *listing, int mode, const SortKey *A, const SortKey *B );
+static void        hc_sortKeys( const Listing *listing, int mode, SortKey *keys, SortKey *temp, int count );
+static void        hc_mergeKeys( const Listing *listing, int mode, const SortKey *source, SortKey *target, int first, int middle, int last );
+static void        hc_sortKeysParallel( const Listing *listing, int mode, nk_bool radix, SortKey *keys, SortKey *temp, int count, int threads );
+static void        hc_sortJob( void *arg );
+static uint64_t    hc_nameWord( const char *name );
+static void        hc_sortKeysByName( const Listing *listing, int mode, SortKey *keys, SortKey *temp, int count );
+static void        hc_sortKeysRadix( const Listing *listing, int mode, SortKey *keys, int count, int depth );
+static void        hc_insertKeys( const Listing *listing, int mode, SortKey *keys, int count, int depth );
+static int         hc_radixCompare( const Listing *listing, int mode, const SortKey *A, const SortKey *B, int depth );
+static void        hc_listingFree( Listing *listing );
+static void        hc_listingRelease( Listing *listing );
+static void        hc_cacheInit( void );
+static nk_bool     hc_cacheKey( const char *path, CacheEntry *key );
+static Listing    *hc_cacheAcquire( const char *path, int options, CacheEntry **pending );
+static void        hc_cachePublish( CacheEntry *entry, Listing *listing );
+static void        hc_cacheRemove( CacheEntry *entry );
+#if defined( __linux__ )
+static void        hc_cacheTouch( Listing *listing );
+static void        hc_cacheForget( Listing *listing );
+static nk_bool     hc_cacheStale( Listing *listing );
+#endif
+static void        hc_listingFormat( const Listing *listing, int entry, TimeFormat *timeFormat, char size[ 20 ], char date[ 11 ], char time[ 9 ], char attr[ 6 ] );
+static void        hc_timeFormatInit( TimeFormat *timeFormat );
+static void        hc_timeFormat( TimeFormat *timeFormat, int64_t seconds, char date[ 11 ], char time[ 9 ] );
+static void        hc_localTime( int64_t seconds, struct tm *tm );
+static int         hc_sizeLength( const Listing *listing, int entry );
+static int         hc_attrLength( int flags );
+static void        hc_listingCount( Listing *listing, int entry, int delta );
+static void        hc_listingMeasure( Listing *listing );
+static int         hc_listingWidth( Listing *listing, const int *widths, int last );
+static void        hc_listingParentFirst( Listing *listing, int parentIndex );
+static void        hc_listingLoadInfo( Listing *listing, int mode, int first, int last );
+#if !defined( _WIN32 ) && !defined( _WIN64 )
+static void        hc_listingFill( Listing *listing, int entry, const struct stat *fileInfo );
+static int         hc_nameFlags( const char *name, nk_bool isDirectory );
+static void        hc_listingStat( Listing *listing, const uint32_t *order, int first, int last, int threads );
+static void        hc_listingStatRange( Listing *listing, const uint32_t *order, int first, int last );
+static void        hc_statJob( void *arg );
+static void        hc_listingDropUnloaded( Listing *listing, int *parentIndex );
+#endif
+static int         hc_statThreads( const char *path );
+static int         hc_statBackend( void );
+#if defined( HC_HAVE_URING )
+static nk_bool     hc_listingStatUring( Listing *listing, const uint32_t *order, int first, int last );
+static nk_bool     hc_uringOpen( URing *ring, unsigned entries );
+static void        hc_uringClose( URing *ring );
+#endif
+static void        hc_watchInit( void );
+static void        hc_watchListing( Listing *listing );
+static void        hc_watchRelease( int wd );
+static void        hc_watchPoll( HC *leftPanel, HC *rightPanel );
+#if defined( __linux__ )
+static int         hc_watchThread( void *data );
+static int         hc_watchChangeCompare( const void *A, const void *B );
+static void        hc_watchApply( HC *leftPanel, HC *rightPanel, int wd, const char *name );
+static void        hc_watchReload( HC *selectedPanel );
+static void        hc_keepSelection( HC *selectedPanel, const char *name, int index );
+static int         hc_listingLowerBound( const Listing *listing, const char *name, int flags );
+static void        hc_listingPlace( Listing *listing, int mode, int entry );
+static int         hc_listingFind( const Listing *listing, const char *name );
+static nk_bool     hc_listingRefreshEntry( Listing *listing, const char *name );
+#endif
+static void        hc_poolInit( void );
+static void        hc_poolShutdown( void );
+static void        hc_poolRun( int workers, void ( *job )( void *arg ), void *arg );
+static int         hc_poolWorker( void *data );
+static nk_bool     hc_envBool( const char *name, nk_bool defaultValue );
+static int         hc_envInt( const char *name, int defaultValue );
 static nk_bool     hc_loadFonts( struct nk_context *ctx, const char *filePath, float height );
 static void        hc_resize( HC *selectedPanel, int col, int row, int maxCol, int maxRow );
 static void        hc_drawPanel( struct nk_context *ctx, HC *selectedPanel );
 static int         hc_findLongestName( HC *selectedPanel );
 static int         hc_findLongestSize( HC *selectedPanel );
 static int         hc_findLongestAttr( HC *selectedPanel );
-static const char *hc_paddedString( HC *selectedPanel, int longestName, int longestSize, int longestAttr, const char *name, const char *size, const char *date, const char *time, const char *attr );
+static void        hc_rowLayout( HC *selectedPanel, int longestName, int longestSize, int longestAttr );
+static void        hc_rowFormat( RowFormat *format, const RowLayout *layout );
+static const char *hc_rowText( HC *selectedPanel, int position, int entry );
+static int         hc_rowEmit( const RowFormat *format, char *line, const char *name, const char *size, const char *date, const char *time, const char *attr );
+static int         hc_rowInfo( char *line, const char *info, int infoLength, int width );
 static int         hc_maxCol( struct nk_context *ctx );
 static int         hc_maxRow( struct nk_context *ctx );
 static void        hc_drawText( struct nk_context *ctx, int col, int row, const char *text, struct nk_color bgColor, struct nk_color textColor );
-static void        hc_drawBox( struct nk_context* ctx, int x, int y, int width, int height, const char *boxString, struct nk_color bgColor, struct nk_color textColor );
+static struct nk_rect hc_cellRect( struct nk_context *ctx, int col, int row, int cols, int rows );
+static void        hc_drawBox( struct nk_context* ctx, BoxCache *cache, int x, int y, int width, int height, const char *boxString, const char *title, struct nk_color bgColor, struct nk_color textColor );
+static nk_bool     hc_boxBuild( BoxCache *cache, int width, const char *boxString );
+static void        hc_gridBegin( struct nk_context *ctx, SDL_Renderer *renderer );
+static void        hc_gridPut( int col, int row, uint32_t codepoint, struct nk_color bgColor, struct nk_color textColor );
+static void        hc_gridFlush( struct nk_context *ctx );
+static void        hc_gridRender( SDL_Renderer *renderer );
+static void        hc_gridFree( void );
 static char       *hc_addStr( const char *firstString, ... );
 static void        hc_changeDir( HC *selectedPanel );
 static const char *hc_dirLastName( const char *path );
@@ -157,16 +723,25 @@ static int         hc_dirIndexName( HC *selectedPanel, const char *tmpDir );
 /* --- */
 static void        hc_utf8CharExtract( const char *source, char *dest, size_t *index );
 static size_t      hc_utf8Len( const char *utf8String );
-static size_t      hc_utf8LenUpTo( const char *utf8String, const char *endPosition );
 static const char *hc_utf8CharPtrAt( const char *utf8String, int characterOffset );
-static int         hc_at( const char *search, const char *string );
-static char       *hc_padR( const char *string, int length );
-static char       *hc_padL( const char *string, int length );
-static char       *hc_left( const char *string, int count );
-static char       *hc_subStr( const char *string, int start, int count );
+static uint32_t    hc_utf8Decode( const char **utf8String );
+static int         hc_utf8Encode( uint32_t codepoint, char *utf8String );
 static char       *hc_strdup( const char *string );
+static char       *hc_frameAlloc( size_t size );
+static void        hc_frameReset( void );
+static void        hc_frameFree( void );
 
 HC *activePanel = NULL;
+static WorkerPool workerPool;
+static ListingCache listingCache;
+static Uint32 wakeEvent = ( Uint32 ) - 1;   /* pushed by loaders and the watcher to wake the event loop */
+static SDL_atomic_t activeLoaders;
+static SDL_atomic_t listingSerials;   /* last Listing serial handed out */
+static ArenaBlock *frameArena;   /* strings of the frame being drawn, see hc_frameAlloc */
+static CellGrid cellGrid;
+#if defined( __linux__ )
+static FileWatch fileWatch = { - 1, NULL, { 0 }, { 0 }, { 0 } };
+#endif
 
 int main( int argc, char *argv[] )
 {
@@ -190,6 +765,9 @@ int main( int argc, char *argv[] )
    NK_UNUSED( argc );
    NK_UNUSED( argv );
 
+   /* the locale sort follows the user's collation rules */
+   setlocale( LC_COLLATE, "" );
+
    SDL_SetHint( SDL_HINT_VIDEO_HIGHDPI_DISABLED, "0" );
    SDL_Init( SDL_INIT_VIDEO );
 
@@ -211,8 +789,18 @@ int main( int argc, char *argv[] )
 
    ctx = nk_sdl_init( window, renderer );
 
+   hc_poolInit();
+   hc_cacheInit();
+   wakeEvent = SDL_RegisterEvents( 1 );
+   hc_watchInit();
+
    leftPanel  = hc_init();
    rightPanel = hc_init();
+   if( leftPanel == NULL || rightPanel == NULL )
+   {
+      SDL_Log( "Error hc_init" );
+      exit( -1 );
+   }
 
    hc_fetchList( leftPanel, hc_cwd() );
    hc_fetchList( rightPanel, hc_cwd() );
@@ -254,6 +842,20 @@ int main( int argc, char *argv[] )
                   }
                   break;
 
+               case SDL_RENDER_TARGETS_RESET:
+               case SDL_RENDER_DEVICE_RESET:
+                  /* the retained cells are gone, the target is made again and drawn in full */
+                  cellGrid.width = 0;
+                  break;
+
+               case SDL_KEYDOWN:
+                  /* Ctrl+F3 name, F4 extension, F5 time, F6 size, F7 unsorted, F8 natural, F9 locale */
+                  if( ( SDL_GetModState() & KMOD_CTRL ) && event.key.keysym.sym >= SDLK_F3 && event.key.keysym.sym <= SDLK_F9 )
+                  {
+                     hc_setSortMode( activePanel, SORT_NAME + ( event.key.keysym.sym - SDLK_F3 ) );
+                  }
+                  break;
+
                default:
                   break;
             }
@@ -268,13 +870,17 @@ int main( int argc, char *argv[] )
          nk_sdl_handle_grab();
          nk_input_end( ctx );
 
+         /* strings of the last frame were handed to nuklear and are no longer used */
+         hc_frameReset();
+
          SDL_SetRenderDrawColor( renderer, 12, 12, 12, 255 );
          SDL_RenderClear( renderer );
          /* --- */
          ctx->style.window.padding.x = 0;
          ctx->style.window.padding.y = 0;
 
-         ctx->style.window.fixed_background = nk_style_item_color( WHITE );
+         /* the panels paint their own cells, see hc_gridRender for the background */
+         ctx->style.window.fixed_background = nk_style_item_hide();
 
          actualWindowFlags = windowFlags;
          if( !( windowFlags & NK_WINDOW_TITLE ) )
@@ -284,7 +890,11 @@ int main( int argc, char *argv[] )
             if( nk_input_is_key_pressed( &ctx->input, NK_KEY_ENTER ) )
             {
                index = activePanel->rowBar + activePanel->rowNo;
-               if( hc_at( "D", activePanel->dirList[ index ].attr ) == 0 )
+               if( index >= activePanel->listing->count )
+               {
+                  /* empty listing, nothing to open */
+               }
+               else if( activePanel->listing->flags[ hc_listingEntry( activePanel->listing, activePanel->sortMode, index ) ] & DIRLIST_DIRECTORY )
                {
                   hc_changeDir( activePanel );
                }
@@ -327,11 +937,11 @@ int main( int argc, char *argv[] )
             }
             else if( nk_input_is_key_pressed( &ctx->input, NK_KEY_DOWN ) )
             {
-               if( activePanel->rowBar < activePanel->maxRow - 3 && activePanel->rowBar <= activePanel->itemCount - 2 )
+               if( activePanel->rowBar < activePanel->maxRow - 3 && activePanel->rowBar <= activePanel->listing->count - 2 )
                {
                   ++activePanel->rowBar;
                }
-               else if( activePanel->rowNo + activePanel->rowBar <= activePanel->itemCount - 2 )
+               else if( activePanel->rowNo + activePanel->rowBar <= activePanel->listing->count - 2 )
                {
                   ++activePanel->rowNo;
                }
@@ -355,24 +965,30 @@ int main( int argc, char *argv[] )
             {
                if( activePanel->rowBar >= hc_maxRow( ctx ) - 4 ) /* ? */
                {
-                  if( activePanel->rowNo + hc_maxRow( ctx ) <= activePanel->itemCount )
+                  if( activePanel->rowNo + hc_maxRow( ctx ) <= activePanel->listing->count )
                   {
                      activePanel->rowNo += hc_maxRow( ctx ) - activePanel->rowBar;
                   }
                }
-               activePanel->rowBar = NK_MIN( hc_maxRow( ctx ) - 4, activePanel->itemCount - activePanel->rowNo - 1 );
+               activePanel->rowBar = NK_MIN( hc_maxRow( ctx ) - 4, activePanel->listing->count - activePanel->rowNo - 1 );
             }
 
+            hc_pollFetchList( leftPanel );
+            hc_pollFetchList( rightPanel );
+            hc_watchPoll( leftPanel, rightPanel );
+
             hc_resize( leftPanel, 0, 0, hc_maxCol( ctx ) / 2, hc_maxRow( ctx ) -3 );
             hc_resize( rightPanel, hc_maxCol( ctx ) / 2, 0, hc_maxCol( ctx ) / 2 -1, hc_maxRow( ctx ) -3 );
 
+            hc_gridBegin( ctx, renderer );
             hc_drawPanel( ctx, leftPanel );
             hc_drawPanel( ctx, rightPanel );
+            hc_gridFlush( ctx );
          }
          nk_end( ctx );
          hc_printInfo( activePanel );
          /* --- */
-         nk_sdl_render( NK_ANTI_ALIASING_ON );
+         hc_gridRender( renderer );
          SDL_RenderPresent( renderer );
       }
    }
@@ -380,6 +996,14 @@ int main( int argc, char *argv[] )
    hc_free( leftPanel );
    hc_free( rightPanel );
    activePanel = NULL;
+   hc_frameFree();
+   hc_gridFree();
+
+   /* loaders still walking a slow directory keep using the pool; the process exit reclaims it */
+   if( SDL_AtomicGet( &activeLoaders ) == 0 )
+   {
+      hc_poolShutdown();
+   }
 
    nk_sdl_shutdown();
    SDL_DestroyRenderer( renderer );
@@ -409,6 +1033,32 @@ static HC *hc_init( void )
    panel->dateVisible = T;
    panel->timeVisible = T;
 
+   panel->lazyInfo = hc_envBool( "HC_LAZY_STAT", F );
+   panel->sortMode = SORT_NAME;
+   panel->pendingSort = - 1;
+   hc_timeFormatInit( &panel->timeFormat );
+
+   panel->fetchSlot = malloc( sizeof( FetchSlot ) );
+   if( !panel->fetchSlot )
+   {
+      fprintf( stderr, "Failed to allocate memory for FetchSlot. \n" );
+      free( panel );
+      return NULL;
+   }
+   memset( panel->fetchSlot, 0, sizeof( FetchSlot ) );
+   SDL_AtomicSet( &panel->fetchSlot->refCount, 1 );
+   panel->fetchSlot->publishMutex = SDL_CreateMutex();
+
+   /* empty until the first hc_fetchList, which keeps it when it cannot start */
+   panel->listing = hc_listingNew();
+   if( !panel->listing )
+   {
+      SDL_DestroyMutex( panel->fetchSlot->publishMutex );
+      free( panel->fetchSlot );
+      free( panel );
+      return NULL;
+   }
+
    return panel;
 }
 
@@ -416,10 +1066,16 @@ static void hc_free( HC *selectedPanel )
 {
    if( selectedPanel )
    {
-      if( selectedPanel->dirList )
+      /* loaders that are still running drop their result once the generation moves on */
+      SDL_AtomicAdd( &selectedPanel->fetchSlot->generation, 1 );
+      hc_fetchSlotRelease( selectedPanel->fetchSlot );
+      hc_listingRelease( selectedPanel->listing );
+      for( int i = 0; i < ROW_CACHE; i++ )
       {
-         free( selectedPanel->dirList );
+         free( selectedPanel->rows[ i ].text );
       }
+      free( selectedPanel->box.top );
+      free( selectedPanel->box.bottom );
       free( selectedPanel );
    }
 }
@@ -436,7 +1092,11 @@ static void hc_printInfo( const HC *selectedPanel )
    printf("   maxCol            : %d\n", selectedPanel->maxCol );
    printf("   maxRow            : %d\n", selectedPanel->maxRow );
    printf("   currentDir        : %s\n", selectedPanel->currentDir );
-   printf("   itemCount         : %d\n", selectedPanel->itemCount );
+   printf("   itemCount         : %d\n", selectedPanel->listing->count );
+   printf("   loading           : %s\n", IIF( selectedPanel->loading, "T", "F" ) );
+   printf("   refCount          : %d\n", selectedPanel->listing->refCount );
+   printf("   allocCount        : %d\n", selectedPanel->listing->allocCount );
+   printf("   nameBytes         : %u\n", selectedPanel->listing->namesSize );
    printf("   rowBar            : %d\n", selectedPanel->rowBar );
    printf("   rowNo             : %d\n", selectedPanel->rowNo );
    printf("   isFirstDirectory  : %s\n", IIF( selectedPanel->isFirstDirectory, "T", "F" ) );
@@ -447,798 +1107,4000 @@ static void hc_printInfo( const HC *selectedPanel )
    printf("   attrVisible       : %s\n", IIF( selectedPanel->attrVisible, "T", "F" ) );
    printf("   dateVisible       : %s\n", IIF( selectedPanel->dateVisible, "T", "F" ) );
    printf("   timeVisible       : %s\n", IIF( selectedPanel->timeVisible, "T", "F" ) );
+   printf("   lazyInfo          : %s\n", IIF( selectedPanel->lazyInfo, "T", "F" ) );
+   printf("   sortMode          : %d\n", selectedPanel->sortMode );
+   printf("   pendingSort       : %d\n", selectedPanel->pendingSort );
+   printf("   statThreads       : %d\n", selectedPanel->listing->statThreads );
+   printf("   statBackend       : %s\n", IIF( selectedPanel->listing->statBackend == STAT_BACKEND_URING, "uring", "sync" ) );
    printf(" ]\n");
 
    fflush( stdout );
 }
 
+/* Starts loading currentDir on a background thread. Until the listing arrives the panel shows
+   a ".." placeholder, so the user can still walk away from a slow directory. When neither can
+   be allocated the panel keeps showing what it showed before. */
 static void hc_fetchList( HC *selectedPanel, const char *currentDir )
 {
-   hc_strncpy( selectedPanel->currentDir, hc_defaultValueChar( currentDir, hc_cwd() ) );
-
-   free( selectedPanel->dirList );
-   selectedPanel->itemCount = 0;
-   selectedPanel->dirList = hc_directory( selectedPanel->currentDir, &selectedPanel->itemCount );
-
-   if( selectedPanel->isFirstDirectory )
+   FetchRequest *request;
+   Listing *placeholder;
+   SDL_Thread *thread;
+   int parent;
+
+   placeholder = hc_listingNew();
+   request = malloc( sizeof( FetchRequest ) );
+   if( !placeholder || !request )
    {
-      qsort( selectedPanel->dirList, selectedPanel->itemCount, sizeof( DirList ), hc_compareDirList );
+      if( !request )
+      {
+         fprintf( stderr, "Failed to allocate memory for FetchRequest. \n" );
+      }
+      hc_listingFree( placeholder );
+      free( request );
+      return;
    }
-}
-
-static int hc_compareDirList( const void *A, const void *B )
-{
-   DirList *dirListA = ( DirList * ) A;
-   DirList *dirListB = ( DirList * ) B;
-
-   // The ".." Directory always comes first
-   if( strcmp( dirListA->name, ".." ) == 0 ) return - 1;
-   if( strcmp( dirListB->name, ".." ) == 0 ) return 1;
 
-   // Directories before dirList
-   nk_bool isDirA = strchr( dirListA->attr, 'D' ) != NULL;
-   nk_bool isDirB = strchr( dirListB->attr, 'D' ) != NULL;
-   if( isDirA != isDirB )
+   /* a reload passes the panel's own path, which must not be copied onto itself */
+   currentDir = hc_defaultValueChar( currentDir, hc_cwd() );
+   if( currentDir != selectedPanel->currentDir )
    {
-      return IIF( isDirA, - 1, 1 );
+      hc_strncpy( selectedPanel->currentDir, currentDir );
    }
 
-   // Hidden dirList/directories after regular ones
-   nk_bool isHiddenA = strchr( dirListA->attr, 'H' ) != NULL;
-   nk_bool isHiddenB = strchr( dirListB->attr, 'H' ) != NULL;
-   if( isHiddenA != isHiddenB )
+   /* streamed rows are drawn from their names and types only, the loader publishes the rest */
+   if( ( parent = hc_listingAppend( placeholder, ".." ) ) != - 1 )
    {
-      return IIF( isHiddenA, 1, - 1 );
+      placeholder->flags[ parent ] = DIRLIST_DIRECTORY | DIRLIST_HIDDEN | DIRLIST_LOADED;
+   }
+   /* streamed batches are then counted as they are appended */
+   hc_listingMeasure( placeholder );
+   hc_listingRelease( selectedPanel->listing );
+   selectedPanel->listing = placeholder;
+   selectedPanel->loading = T;
+
+   /* a sort still on its way is for the old listing; the loader sorts the new one by its mode */
+   if( selectedPanel->pendingSort != - 1 )
+   {
+      selectedPanel->sortMode = selectedPanel->pendingSort;
+      selectedPanel->pendingSort = - 1;
    }
 
-   return strcmp( dirListA->name, dirListB->name );
+   request->slot       = selectedPanel->fetchSlot;
+   request->generation = SDL_AtomicAdd( &selectedPanel->fetchSlot->generation, 1 ) + 1;
+   request->lazyInfo   = selectedPanel->lazyInfo;
+   request->sortList   = selectedPanel->isFirstDirectory;
+   request->sortMode   = selectedPanel->sortMode;
+   request->published   = 0;
+   request->lastPublish = 0;
+   request->cancelled   = F;
+   hc_strncpy( request->path, selectedPanel->currentDir );
+   SDL_AtomicSet( &selectedPanel->fetchSlot->progress, 0 );
+
+   SDL_AtomicAdd( &request->slot->refCount, 1 );
+   SDL_AtomicAdd( &activeLoaders, 1 );
+
+   thread = SDL_CreateThread( hc_fetchWorker, "hc_fetch", request );
+   if( thread )
+   {
+      SDL_DetachThread( thread );
+   }
+   else
+   {
+      hc_fetchWorker( request );
+      hc_pollFetchList( selectedPanel );
+   }
 }
 
-const char *hc_cwd( void )
+static int hc_fetchWorker( void *data )
 {
-   static char result[ PATH_MAX ];
-   size_t len;
-   char separator;
-
-   if( GET_CURRENT_DIR( result, sizeof( result ) ) )
+   FetchRequest *request = data;
+   FetchSlot *slot = request->slot;
+   CacheEntry *pending = NULL;
+   Listing *listing;
+   int options = IIF( request->lazyInfo, LISTING_LAZY, 0 ) | IIF( request->sortList, LISTING_SORTED, 0 );
+
+   /* a newer request made this one obsolete before it even started */
+   if( SDL_AtomicGet( &slot->generation ) == request->generation )
    {
-      len = strlen( result );
-      separator = PS[ 0 ];
-
-      /* Checking if the path length is within the buffer limits */
-      if( len >= ( sizeof( result ) - 2 ) )
+      /* another panel showing the same directory makes this a cache hit */
+      listing = hc_cacheAcquire( request->path, options, &pending );
+      if( !listing )
       {
-         fprintf( stderr, "Error: Path exceeds the allowed buffer size. \n" );
-         return NULL;
+         listing = hc_directory( request->path, request->lazyInfo, hc_fetchProgress, request );
+         if( !listing )
+         {
+            request->cancelled = T;
+            listing = hc_listingNew();
+         }
+
+         /* an abandoned listing is only handed over empty, there is nothing to sort */
+         if( listing && request->sortList && !request->cancelled )
+         {
+            hc_listingSort( listing, request->sortMode );
+         }
+
+         if( listing )
+         {
+            hc_listingMeasure( listing );
+         }
+
+         if( pending )
+         {
+            hc_cachePublish( pending, IIF( request->cancelled, NULL, listing ) );
+         }
       }
 
-      /* Checking if there is already a separator at the end of the path */
-      if( result[ len - 1 ] != separator )
+      if( listing )
       {
-         result[ len ] = separator;
-         result[ len + 1 ] = '\0';
+         SDL_LockMutex( slot->publishMutex );
+         if( slot->ready && slot->readyGeneration > request->generation )
+         {
+            hc_listingRelease( listing );
+         }
+         else
+         {
+            hc_listingRelease( slot->ready );
+            slot->ready = listing;
+            slot->readyGeneration = request->generation;
+         }
+         SDL_UnlockMutex( slot->publishMutex );
+
+         hc_wakeEventLoop();
       }
+   }
 
-      return result;
+   hc_fetchSlotRelease( slot );
+   SDL_AtomicAdd( &activeLoaders, - 1 );
+   free( request );
+
+   return 0;
+}
+
+/* Hands the entries read since the last call to the panel, at most every STREAM_INTERVAL ms
+   except for the first batch, which goes out at once. Stops the enumeration when it became stale. */
+static nk_bool hc_fetchProgress( Listing *listing, void *userData )
+{
+   FetchRequest *request = userData;
+   FetchSlot *slot = request->slot;
+   Uint32 now = SDL_GetTicks();
+   Listing *batch;
+
+   if( SDL_AtomicGet( &slot->generation ) != request->generation )
+   {
+      request->cancelled = T;
+      return F;
    }
-   else
+
+   SDL_AtomicSet( &slot->progress, listing->count );
+
+   if( listing->count == request->published || ( request->published > 0 && now - request->lastPublish < STREAM_INTERVAL ) )
    {
-      fprintf( stderr, "Error: hc_cwd. \n" );
-      return NULL;
+      return T;
    }
-}
 
-static const char *hc_defaultValueChar( const char *A, const char *B )
-{
-   return IIF( A && *A, A, B );
-}
+   batch = hc_listingNew();
+   if( !batch || !hc_listingAppendFrom( batch, listing, request->published, listing->count - request->published, F ) )
+   {
+      hc_listingFree( batch );
+      return T;
+   }
 
-static void hc_strncpy( char oldValue[ PATH_MAX ], const char *newValue )
-{
-   if( newValue )
+   SDL_LockMutex( slot->publishMutex );
+   if( slot->partial && slot->partialGeneration == request->generation )
    {
-      strncpy( oldValue, newValue, PATH_MAX - 1 );
-      oldValue[ PATH_MAX - 1 ] = '\0';
+      /* the panel has not picked up the previous batch yet */
+      hc_listingAppendFrom( slot->partial, batch, 0, batch->count, F );
+      hc_listingFree( batch );
    }
    else
    {
-      oldValue[ 0 ] = '\0';
+      hc_listingFree( slot->partial );
+      slot->partial = batch;
+      slot->partialGeneration = request->generation;
    }
+   SDL_UnlockMutex( slot->publishMutex );
+
+   request->published   = listing->count;
+   request->lastPublish = now;
+
+   hc_wakeEventLoop();
+
+   return T;
 }
 
-static DirList *hc_directory( const char *currentDir, int *size )
+static void hc_wakeEventLoop( void )
 {
-#if defined( _WIN32 ) || defined( _WIN64 )
-   DirList *files = NULL;
-   int count = 0;
-   int parentIndex = -1;
-
-   WIN32_FIND_DATA findFileData;
-   char fullPath[ PATH_MAX ];
-   snprintf( fullPath, sizeof( fullPath ), "%s\\*", currentDir );
-   HANDLE hFind = FindFirstFile( fullPath, &findFileData );
+   if( wakeEvent != ( Uint32 ) - 1 )
+   {
+      SDL_Event event;
+      memset( &event, 0, sizeof( event ) );
+      event.type = wakeEvent;
+      SDL_PushEvent( &event );
+   }
+}
 
-   if( hFind == INVALID_HANDLE_VALUE )
+/* Appends streamed entries to the placeholder while loading, then installs the finished,
+   sorted listing when it answers the latest request. The bar stays on the entry it was on. */
+static void hc_pollFetchList( HC *selectedPanel )
+{
+   FetchSlot *slot = selectedPanel->fetchSlot;
+   int generation = SDL_AtomicGet( &slot->generation );
+   Listing *partial;
+   Listing *ready;
+   SortRequest *sorted;
+   nk_bool partialCurrent;
+   nk_bool readyCurrent;
+
+   SDL_LockMutex( slot->publishMutex );
+   partial = slot->partial;
+   ready   = slot->ready;
+   sorted  = slot->sorted;
+   partialCurrent = slot->partialGeneration == generation;
+   readyCurrent   = slot->readyGeneration == generation;
+   slot->partial = NULL;
+   slot->ready   = NULL;
+   slot->sorted  = NULL;
+   SDL_UnlockMutex( slot->publishMutex );
+
+   if( partial )
    {
-      fprintf( stderr, "Directory cannot be opened: %s\n", currentDir );
-      return NULL;
+      if( partialCurrent && selectedPanel->loading )
+      {
+         /* the placeholder already starts with ".." */
+         hc_listingAppendFrom( selectedPanel->listing, partial, 0, partial->count, T );
+      }
+      hc_listingFree( partial );
    }
 
-   files = malloc( sizeof( DirList ) * INITIAL_FPCSR );
-   if( !files )
+   if( ready && !readyCurrent )
    {
-      fprintf( stderr, "Memory allocation error.\n" );
-      FindClose( hFind );
-      return NULL;
+      hc_listingRelease( ready );
+      ready = NULL;
    }
 
-   do
+   if( ready )
    {
-      if( strcmp( findFileData.cFileName, "." ) == 0 )
+      if( !selectedPanel->selectName[ 0 ] && selectedPanel->rowBar + selectedPanel->rowNo > 0 &&
+          selectedPanel->rowBar + selectedPanel->rowNo < selectedPanel->listing->count )
       {
-         continue;
+         hc_strncpy( selectedPanel->selectName, hc_listingNameAt( selectedPanel->listing, selectedPanel->sortMode, selectedPanel->rowBar + selectedPanel->rowNo ) );
       }
 
-      if( strcmp( findFileData.cFileName, ".." ) == 0 )
+      hc_listingRelease( selectedPanel->listing );
+      selectedPanel->listing = ready;
+      selectedPanel->loading = F;
+      hc_watchListing( ready );
+
+      if( selectedPanel->selectName[ 0 ] )
       {
-         parentIndex = count;
+         hc_selectName( selectedPanel, selectedPanel->selectName );
+         selectedPanel->selectName[ 0 ] = '\0';
       }
-
-      if( count >= INITIAL_FPCSR )
+      else
       {
-         DirList *temp = realloc( files, sizeof( DirList ) * ( count + 1 ) );
-         if( !temp )
-         {
-            fprintf( stderr, "Memory allocation error.\n" );
-            FindClose( hFind );
-            free( files );
-            return NULL;
-         }
-         files = temp;
+         selectedPanel->rowBar = NK_MIN( selectedPanel->rowBar, NK_MAX( selectedPanel->listing->count - 1, 0 ) );
+         selectedPanel->rowNo  = 0;
       }
 
-      files[ count ].state = F;
-      strncpy( files[ count ].name, findFileData.cFileName, sizeof( files[ count ].name ) - 1 );
-      files[ count ].name[ sizeof( files[ count ].name ) - 1 ] = '\0';
-
-      LARGE_INTEGER fileSize;
-      fileSize.LowPart = findFileData.nFileSizeLow;
-      fileSize.HighPart = findFileData.nFileSizeHigh;
-      snprintf( files[ count ].size, sizeof( files[ count ].size ), "%lld", fileSize.QuadPart );
-
-      FILETIME ft = findFileData.ftLastWriteTime;
-      SYSTEMTIME st;
-      FileTimeToLocalFileTime( &ft, &ft );
-      FileTimeToSystemTime( &ft, &st );
-
-      struct tm tm = ConvertSystemTimeToTm( &st );
-      strftime( files[ count ].date, sizeof( files[ count ].date ), "%d-%m-%Y", &tm );
-      strftime( files[ count ].time, sizeof( files[ count ].time ), "%H:%M:%S", &tm );
-
-      strcpy( files[ count ].attr, "" );
-      if( findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+#if defined( __linux__ )
+      /* the watch only sees changes from now on, those made while the directory was read need a reload */
+      if( hc_cacheStale( ready ) )
       {
-         strcat( files[ count ].attr, "D" );
+         hc_watchReload( selectedPanel );
       }
-      if( findFileData.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN )
+#endif
+   }
+
+   hc_pollSort( selectedPanel, sorted );
+}
+
+static void hc_fetchSlotRelease( FetchSlot *slot )
+{
+   if( SDL_AtomicAdd( &slot->refCount, - 1 ) == 1 )
+   {
+      hc_listingRelease( slot->ready );
+      hc_listingFree( slot->partial );
+      while( slot->sorted )
+      {
+         SortRequest *next = slot->sorted->next;
+         hc_listingFree( slot->sorted->listing );
+         free( slot->sorted );
+         slot->sorted = next;
+      }
+      SDL_DestroyMutex( slot->publishMutex );
+      free( slot );
+   }
+}
+
+/* Has the listing of a panel sorted by `mode` on a loader thread, working on a copy; the panel
+   switches to it in hc_pollSort */
+static void hc_fetchSort( HC *selectedPanel, int mode )
+{
+   SortRequest *request;
+   SDL_Thread *thread;
+
+   if( selectedPanel->pendingSort == mode )
+   {
+      return;
+   }
+
+   request = malloc( sizeof( SortRequest ) );
+   if( !request )
+   {
+      fprintf( stderr, "Failed to allocate memory for SortRequest. \n" );
+      return;
+   }
+   request->listing = hc_listingCopy( selectedPanel->listing );
+   if( !request->listing )
+   {
+      free( request );
+      return;
+   }
+
+   request->slot       = selectedPanel->fetchSlot;
+   request->generation = SDL_AtomicGet( &selectedPanel->fetchSlot->generation );
+   request->mode       = mode;
+   request->serial     = selectedPanel->listing->serial;
+   request->edits      = selectedPanel->listing->edits;
+   request->next       = NULL;
+   selectedPanel->pendingSort = mode;
+
+   SDL_AtomicAdd( &request->slot->refCount, 1 );
+   SDL_AtomicAdd( &activeLoaders, 1 );
+
+   thread = SDL_CreateThread( hc_sortWorker, "hc_sort", request );
+   if( thread )
+   {
+      SDL_DetachThread( thread );
+   }
+   else
+   {
+      /* taken by the next hc_pollFetchList */
+      hc_sortWorker( request );
+   }
+}
+
+static int hc_sortWorker( void *data )
+{
+   SortRequest *request = data;
+   FetchSlot *slot = request->slot;
+
+   /* a fetch made the copy obsolete before it was sorted */
+   if( SDL_AtomicGet( &slot->generation ) == request->generation )
+   {
+      hc_listingSort( request->listing, request->mode );
+
+      SDL_LockMutex( slot->publishMutex );
+      request->next = slot->sorted;
+      slot->sorted = request;
+      SDL_UnlockMutex( slot->publishMutex );
+
+      hc_wakeEventLoop();
+   }
+   else
+   {
+      hc_listingFree( request->listing );
+      free( request );
+   }
+
+   hc_fetchSlotRelease( slot );
+   SDL_AtomicAdd( &activeLoaders, - 1 );
+
+   return 0;
+}
+
+/* Takes over the orders background sorts built while the listing they copied is still shown
+   unchanged; one that changed meanwhile is sorted again. Switches to the mode the panel waits
+   for once its order exists. A listing that arrived without the order of the shown mode shows
+   its read order until that one is sorted. */
+static void hc_pollSort( HC *selectedPanel, SortRequest *request )
+{
+   Listing *listing = selectedPanel->listing;
+   int generation = SDL_AtomicGet( &selectedPanel->fetchSlot->generation );
+   int mode;
+
+   while( request )
+   {
+      SortRequest *next = request->next;
+      nk_bool sameListing = request->generation == generation && request->serial == listing->serial;
+      nk_bool changed = sameListing && request->edits != listing->edits;
+
+      mode = request->mode;
+      if( sameListing && !changed && !listing->orders[ mode ] && request->listing->orders[ mode ] &&
+          !hc_listingAdopt( listing, request->listing, mode ) )
+      {
+         fprintf( stderr, "Memory allocation error.\n" );
+      }
+      hc_listingFree( request->listing );
+      free( request );
+
+      if( mode == selectedPanel->pendingSort && !listing->orders[ mode ] )
+      {
+         /* nothing to show: the sort failed or has to be done again */
+         selectedPanel->pendingSort = - 1;
+         if( changed )
+         {
+            hc_fetchSort( selectedPanel, mode );
+         }
+      }
+      request = next;
+   }
+
+   if( selectedPanel->loading || !listing->sorted || listing->count == 0 )
+   {
+      return;
+   }
+
+   mode = selectedPanel->pendingSort;
+   if( mode != - 1 && listing->orders[ mode ] )
+   {
+      hc_setSortMode( selectedPanel, mode );
+   }
+   else if( mode == - 1 && !listing->orders[ selectedPanel->sortMode ] )
+   {
+      mode = selectedPanel->sortMode;
+      selectedPanel->sortMode = SORT_UNSORTED;
+      hc_fetchSort( selectedPanel, mode );
+   }
+}
+
+/* Shows the listing of a panel in another SORT_* order, keeping the bar on its entry and
+   scrolling only when that entry left the visible rows */
+static void hc_setSortMode( HC *selectedPanel, int mode )
+{
+   Listing *listing = selectedPanel->listing;
+   int position = selectedPanel->rowBar + selectedPanel->rowNo;
+   int entry;
+
+   if( mode == selectedPanel->sortMode )
+   {
+      selectedPanel->pendingSort = - 1;
+      return;
+   }
+
+   /* the current order stays on screen until a loader has sorted the listing */
+   if( listing->sorted && listing->count > 0 && !listing->orders[ mode ] )
+   {
+      hc_fetchSort( selectedPanel, mode );
+      return;
+   }
+   selectedPanel->pendingSort = - 1;
+
+   entry = IIF( listing && position < listing->count, hc_listingEntry( listing, selectedPanel->sortMode, position ), - 1 );
+   selectedPanel->sortMode = mode;
+   if( entry == - 1 )
+   {
+      return;
+   }
+
+   position = NK_MAX( hc_listingPosition( listing, mode, entry ), 0 );
+   if( position < selectedPanel->rowNo || position - selectedPanel->rowNo > selectedPanel->maxRow - 3 )
+   {
+      selectedPanel->rowNo = NK_MAX( position - selectedPanel->rowBar, 0 );
+   }
+   selectedPanel->rowBar = position - selectedPanel->rowNo;
+}
+
+/* Puts the bar on the entry called name, or on the first entry after ".." when it is missing */
+static void hc_selectName( HC *selectedPanel, const char *name )
+{
+   int lastPosition = NK_MAX( hc_dirIndexName( selectedPanel, name ), 1 );
+
+   if( lastPosition > selectedPanel->maxRow - 3 )
+   {
+      selectedPanel->rowBar = selectedPanel->maxRow - 3;
+      selectedPanel->rowNo  = lastPosition - selectedPanel->rowBar;
+   }
+   else
+   {
+      selectedPanel->rowNo  = 0;
+      selectedPanel->rowBar = lastPosition;
+   }
+}
+
+static int hc_compareEntries( const char *nameA, int flagsA, const char *nameB, int flagsB )
+{
+   // The ".." Directory always comes first
+   if( strcmp( nameA, ".." ) == 0 ) return - 1;
+   if( strcmp( nameB, ".." ) == 0 ) return 1;
+
+   // Directories before dirList
+   nk_bool isDirA = ( flagsA & DIRLIST_DIRECTORY ) != 0;
+   nk_bool isDirB = ( flagsB & DIRLIST_DIRECTORY ) != 0;
+   if( isDirA != isDirB )
+   {
+      return IIF( isDirA, - 1, 1 );
+   }
+
+   // Hidden dirList/directories after regular ones
+   nk_bool isHiddenA = ( flagsA & DIRLIST_HIDDEN ) != 0;
+   nk_bool isHiddenB = ( flagsB & DIRLIST_HIDDEN ) != 0;
+   if( isHiddenA != isHiddenB )
+   {
+      return IIF( isHiddenA, 1, - 1 );
+   }
+
+   return strcmp( nameA, nameB );
+}
+
+const char *hc_cwd( void )
+{
+   static char result[ PATH_MAX ];
+   size_t len;
+   char separator;
+
+   if( GET_CURRENT_DIR( result, sizeof( result ) ) )
+   {
+      len = strlen( result );
+      separator = PS[ 0 ];
+
+      /* Checking if the path length is within the buffer limits */
+      if( len >= ( sizeof( result ) - 2 ) )
+      {
+         fprintf( stderr, "Error: Path exceeds the allowed buffer size. \n" );
+         return NULL;
+      }
+
+      /* Checking if there is already a separator at the end of the path */
+      if( result[ len - 1 ] != separator )
+      {
+         result[ len ] = separator;
+         result[ len + 1 ] = '\0';
+      }
+
+      return result;
+   }
+   else
+   {
+      fprintf( stderr, "Error: hc_cwd. \n" );
+      return NULL;
+   }
+}
+
+static const char *hc_defaultValueChar( const char *A, const char *B )
+{
+   return IIF( A && *A, A, B );
+}
+
+static void hc_strncpy( char oldValue[ PATH_MAX ], const char *newValue )
+{
+   if( newValue )
+   {
+      strncpy( oldValue, newValue, PATH_MAX - 1 );
+      oldValue[ PATH_MAX - 1 ] = '\0';
+   }
+   else
+   {
+      oldValue[ 0 ] = '\0';
+   }
+}
+
+static Listing *hc_directory( const char *currentDir, nk_bool lazyInfo, ListingProgress progress, void *userData )
+{
+#if defined( _WIN32 ) || defined( _WIN64 )
+   Listing *listing;
+   int index;
+   int parentIndex = -1;
+
+   WIN32_FIND_DATA findFileData;
+   char fullPath[ PATH_MAX ];
+   snprintf( fullPath, sizeof( fullPath ), "%s\\*", currentDir );
+   HANDLE hFind = FindFirstFile( fullPath, &findFileData );
+
+   if( hFind == INVALID_HANDLE_VALUE )
+   {
+      fprintf( stderr, "Directory cannot be opened: %s\n", currentDir );
+      return NULL;
+   }
+
+   NK_UNUSED( lazyInfo );
+
+   listing = hc_listingNew();
+   if( !listing )
+   {
+      fprintf( stderr, "Memory allocation error.\n" );
+      FindClose( hFind );
+      return NULL;
+   }
+   hc_strncpy( listing->path, currentDir );
+
+   do
+   {
+      if( strcmp( findFileData.cFileName, "." ) == 0 )
+      {
+         continue;
+      }
+
+      if( strcmp( findFileData.cFileName, ".." ) == 0 )
+      {
+         parentIndex = listing->count;
+      }
+
+      index = hc_listingAppend( listing, findFileData.cFileName );
+      if( index == - 1 )
+      {
+         fprintf( stderr, "Memory allocation error.\n" );
+         FindClose( hFind );
+         hc_listingFree( listing );
+         return NULL;
+      }
+
+      LARGE_INTEGER fileSize;
+      fileSize.LowPart = findFileData.nFileSizeLow;
+      fileSize.HighPart = findFileData.nFileSizeHigh;
+      listing->size[ index ] = fileSize.QuadPart;
+
+      /* FILETIME counts 100 ns intervals since 1601-01-01 UTC */
+      ULARGE_INTEGER writeTime;
+      writeTime.LowPart  = findFileData.ftLastWriteTime.dwLowDateTime;
+      writeTime.HighPart = findFileData.ftLastWriteTime.dwHighDateTime;
+      listing->mtime[ index ] = ( int64_t ) ( ( writeTime.QuadPart - 116444736000000000ULL ) / 10000000ULL );
+
+      listing->flags[ index ] = DIRLIST_STATED | DIRLIST_LOADED;
+      if( findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+      {
+         listing->flags[ index ] |= DIRLIST_DIRECTORY;
+      }
+      if( findFileData.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN )
+      {
+         listing->flags[ index ] |= DIRLIST_HIDDEN;
+      }
+
+      if( progress && listing->count % STREAM_BATCH == 0 && !progress( listing, userData ) )
+      {
+         FindClose( hFind );
+         hc_listingFree( listing );
+         return NULL;
+      }
+   }
+   while( FindNextFile( hFind, &findFileData ) != 0 );
+
+   FindClose( hFind );
+
+   hc_listingParentFirst( listing, parentIndex );
+
+   return listing;
+#elif defined( __linux__ )
+   /* The directory is opened once; entries arrive in large getdents64 batches and
+      are stat'ed relative to the directory descriptor, so the kernel never re-walks the path.
+      In lazy mode d_type alone classifies the entry and the stat is left for hc_listingLoadInfo */
+   Listing *listing;
+   int index;
+   int parentIndex = - 1;
+
+   int dirFd;
+   char *buffer;
+   long bytesRead;
+   struct stat fileInfo;
+   int statThreads = hc_statThreads( currentDir );
+   int statBackend = hc_statBackend();
+   nk_bool batchStat = statThreads > 1 || statBackend != STAT_BACKEND_SYNC;
+
+   dirFd = open( currentDir, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+   if( dirFd == - 1 )
+   {
+      fprintf( stderr, "Directory cannot be opened: %s\n", currentDir );
+      return NULL;
+   }
+
+   buffer = malloc( GETDENTS_BUFFER );
+   listing = hc_listingNew();
+   if( !buffer || !listing )
+   {
+      close( dirFd );
+      free( buffer );
+      hc_listingFree( listing );
+      return NULL;
+   }
+   hc_strncpy( listing->path, currentDir );
+   listing->dirFd       = dirFd;
+   listing->statThreads = statThreads;
+   listing->statBackend = statBackend;
+
+   while( ( bytesRead = syscall( SYS_getdents64, dirFd, buffer, GETDENTS_BUFFER ) ) > 0 )
+   {
+      long offset = 0;
+
+      while( offset < bytesRead )
+      {
+         struct _LinuxDirent64 *entry = ( struct _LinuxDirent64 * ) ( buffer + offset );
+         offset += entry->d_reclen;
+
+         nk_bool typeKnown = entry->d_type == DT_DIR || entry->d_type == DT_REG;
+         nk_bool statLater = IIF( lazyInfo, typeKnown, batchStat );
+
+         if( strcmp( entry->d_name, "." ) == 0 )
+         {
+            continue;
+         }
+
+         if( !statLater && fstatat( dirFd, entry->d_name, &fileInfo, 0 ) == - 1 )
+         {
+            perror( "Error getting file info" );
+            continue;
+         }
+
+         if( strcmp( entry->d_name, ".." ) == 0 )
+         {
+            parentIndex = listing->count;
+         }
+
+         index = hc_listingAppend( listing, entry->d_name );
+         if( index == - 1 )
+         {
+            free( buffer );
+            hc_listingFree( listing );
+            return NULL;
+         }
+
+         if( statLater )
+         {
+            listing->flags[ index ] = hc_nameFlags( entry->d_name, entry->d_type == DT_DIR );
+         }
+         else
+         {
+            hc_listingFill( listing, index, &fileInfo );
+         }
+      }
+
+      if( progress && !progress( listing, userData ) )
+      {
+         free( buffer );
+         hc_listingFree( listing );
+         return NULL;
+      }
+   }
+
+   if( bytesRead == - 1 )
+   {
+      perror( "Error reading directory" );
+   }
+
+   free( buffer );
+
+   if( !lazyInfo )
+   {
+      if( batchStat )
+      {
+         hc_listingStat( listing, listing->orders[ SORT_UNSORTED ], 0, listing->count, statThreads );
+         hc_listingDropUnloaded( listing, &parentIndex );
+      }
+      close( dirFd );
+      listing->dirFd = - 1;
+   }
+
+   hc_listingParentFirst( listing, parentIndex );
+
+   return listing;
+#else
+   Listing *listing;
+   int index;
+   int parentIndex = - 1;
+
+   DIR *pDir;
+   struct dirent *entry;
+   struct stat fileInfo;
+   int statThreads = hc_statThreads( currentDir );
+
+   pDir = opendir( currentDir );
+   if( pDir == NULL )
+   {
+      fprintf( stderr, "Directory cannot be opened: %s\n", currentDir );
+      return NULL;
+   }
+
+   listing = hc_listingNew();
+   if( !listing )
+   {
+      closedir( pDir );
+      return NULL;
+   }
+   hc_strncpy( listing->path, currentDir );
+   listing->statThreads = statThreads;
+
+   while( ( entry = readdir( pDir ) ) != NULL )
+   {
+      nk_bool typeKnown = F;
+      nk_bool isDirectory = F;
+      nk_bool statLater;
+#if defined( DT_DIR )
+      typeKnown   = entry->d_type == DT_DIR || entry->d_type == DT_REG;
+      isDirectory = entry->d_type == DT_DIR;
+#endif
+      statLater = IIF( lazyInfo, typeKnown, statThreads > 1 );
+
+      if( strcmp( entry->d_name, "." ) == 0 )
+      {
+         continue;
+      }
+
+      if( !statLater )
+      {
+         char fullPath[ PATH_MAX ];
+         snprintf( fullPath, sizeof( fullPath ), "%s/%s", currentDir, entry->d_name );
+
+         if( stat( fullPath, &fileInfo ) == - 1 )
+         {
+            perror( "Error getting file info" );
+            continue;
+         }
+      }
+
+      if( strcmp( entry->d_name, ".." ) == 0 )
+      {
+         parentIndex = listing->count;
+      }
+
+      index = hc_listingAppend( listing, entry->d_name );
+      if( index == - 1 )
+      {
+         closedir( pDir );
+         hc_listingFree( listing );
+         return NULL;
+      }
+
+      if( statLater )
+      {
+         listing->flags[ index ] = hc_nameFlags( entry->d_name, isDirectory );
+      }
+      else
+      {
+         hc_listingFill( listing, index, &fileInfo );
+      }
+
+      if( progress && listing->count % STREAM_BATCH == 0 && !progress( listing, userData ) )
+      {
+         closedir( pDir );
+         hc_listingFree( listing );
+         return NULL;
+      }
+   }
+
+   closedir( pDir );
+
+   if( !lazyInfo && statThreads > 1 )
+   {
+      hc_listingStat( listing, listing->orders[ SORT_UNSORTED ], 0, listing->count, statThreads );
+      hc_listingDropUnloaded( listing, &parentIndex );
+   }
+
+   hc_listingParentFirst( listing, parentIndex );
+
+   return listing;
+#endif
+}
+
+#if !defined( _WIN32 ) && !defined( _WIN64 )
+static void hc_listingFill( Listing *listing, int entry, const struct stat *fileInfo )
+{
+   uint8_t flags = DIRLIST_STATED | DIRLIST_LOADED | ( listing->flags[ entry ] & DIRLIST_SELECTED );
+
+   listing->size[ entry ]  = fileInfo->st_size;
+   listing->mtime[ entry ] = fileInfo->st_mtime;
+   listing->mode[ entry ]  = fileInfo->st_mode;
+
+   if( S_ISREG( fileInfo->st_mode ) )
+   {
+      flags |= DIRLIST_ARCHIVE;
+      if( fileInfo->st_mode & S_IXUSR )
+      {
+         flags |= DIRLIST_EXECUTABLE;
+      }
+   }
+   if( S_ISDIR( fileInfo->st_mode ) )
+   {
+      flags |= DIRLIST_DIRECTORY;
+   }
+   if( hc_listingName( listing, entry )[ 0 ] == '.' )
+   {
+      flags |= DIRLIST_HIDDEN;
+   }
+
+   listing->flags[ entry ] = flags;
+}
+
+/* Flags of an entry known by name and type only, all the sort needs; the remaining columns
+   come later from hc_listingLoadInfo */
+static int hc_nameFlags( const char *name, nk_bool isDirectory )
+{
+   return IIF( isDirectory, DIRLIST_DIRECTORY, DIRLIST_ARCHIVE ) | IIF( name[ 0 ] == '.', DIRLIST_HIDDEN, 0 );
+}
+#endif
+
+/* Formats the columns of one entry; size, date and time stay empty until it has been stat'ed */
+static void hc_listingFormat( const Listing *listing, int entry, TimeFormat *timeFormat, char size[ 20 ], char date[ 11 ], char time[ 9 ], char attr[ 6 ] )
+{
+   int flags = listing->flags[ entry ];
+   int length = 0;
+
+   if( flags & DIRLIST_STATED )
+   {
+      snprintf( size, 20, "%lld", ( long long ) listing->size[ entry ] );
+      hc_timeFormat( timeFormat, listing->mtime[ entry ], date, time );
+   }
+   else
+   {
+      size[ 0 ] = '\0';
+      date[ 0 ] = '\0';
+      time[ 0 ] = '\0';
+   }
+
+   if( flags & DIRLIST_ARCHIVE )    attr[ length++ ] = 'A';
+   if( flags & DIRLIST_EXECUTABLE ) attr[ length++ ] = 'E';
+   if( flags & DIRLIST_DIRECTORY )  attr[ length++ ] = 'D';
+   if( flags & DIRLIST_HIDDEN )     attr[ length++ ] = 'H';
+   attr[ length ] = '\0';
+}
+
+/* Number of characters of the size column */
+static int hc_sizeLength( const Listing *listing, int entry )
+{
+   int64_t size = listing->size[ entry ];
+   int length = 1;
+
+   if( !( listing->flags[ entry ] & DIRLIST_STATED ) )
+   {
+      return 0;
+   }
+
+   if( size < 0 )
+   {
+      ++length;
+      size = - size;
+   }
+   while( size >= 10 )
+   {
+      size /= 10;
+      ++length;
+   }
+   return length;
+}
+
+/* Number of characters of the attr column */
+static int hc_attrLength( int flags )
+{
+   return ( ( flags & DIRLIST_ARCHIVE ) != 0 ) + ( ( flags & DIRLIST_EXECUTABLE ) != 0 ) +
+          ( ( flags & DIRLIST_DIRECTORY ) != 0 ) + ( ( flags & DIRLIST_HIDDEN ) != 0 );
+}
+
+/* Adds ( delta 1 ) or takes back ( delta - 1 ) the column widths of an entry once the listing
+   has been measured. Callers take an entry back before changing its columns and add it again after. */
+static void hc_listingCount( Listing *listing, int entry, int delta )
+{
+   if( !listing->measured )
+   {
+      return;
+   }
+   listing->nameWidths[ NK_MIN( ( int ) hc_utf8Len( hc_listingName( listing, entry ) ), WIDTH_MAX ) ] += delta;
+   listing->sizeWidths[ hc_sizeLength( listing, entry ) ] += delta;
+   listing->attrWidths[ hc_attrLength( listing->flags[ entry ] ) ] += delta;
+}
+
+/* Counts the column widths of every entry. Loaders measure the listings they build, so drawing
+   only reads the counts; from then on the counts follow every change, so removing the widest
+   entry needs no rescan. */
+static void hc_listingMeasure( Listing *listing )
+{
+   int i;
+
+   if( listing->measured )
+   {
+      return;
+   }
+
+   listing->measured = T;
+   for( i = 0; i < listing->count; i++ )
+   {
+      hc_listingCount( listing, i, 1 );
+   }
+}
+
+/* Widest value of a column, widths counted up to last. A listing no loader measured is measured here. */
+static int hc_listingWidth( Listing *listing, const int *widths, int last )
+{
+   hc_listingMeasure( listing );
+
+   while( last > 0 && widths[ last ] == 0 )
+   {
+      --last;
+   }
+   return last;
+}
+
+static void hc_timeFormatInit( TimeFormat *timeFormat )
+{
+   timeFormat->dayStart = 0;
+   timeFormat->dayEnd   = 0;
+   timeFormat->date[ 0 ] = '\0';
+}
+
+/* Formats seconds as "%d-%m-%Y" and "%H:%M:%S" in local time. localtime_r runs once per calendar
+   day; days whose UTC offset changes halfway (daylight saving) are never cached. */
+static void hc_timeFormat( TimeFormat *timeFormat, int64_t seconds, char date[ 11 ], char time[ 9 ] )
+{
+   int64_t secondOfDay;
+   int hour, minute, second;
+
+   if( seconds < timeFormat->dayStart || seconds >= timeFormat->dayEnd )
+   {
+      struct tm tm;
+      struct tm edge;
+
+      hc_localTime( seconds, &tm );
+      strftime( timeFormat->date, sizeof( timeFormat->date ), "%d-%m-%Y", &tm );
+
+      timeFormat->dayStart = seconds - ( tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec );
+      timeFormat->dayEnd   = timeFormat->dayStart + 86400;
+
+      /* a regular day starts at 00:00:00 and ends at 23:59:59 of the same date */
+      hc_localTime( timeFormat->dayStart, &edge );
+      if( edge.tm_mday == tm.tm_mday && edge.tm_hour == 0 && edge.tm_min == 0 && edge.tm_sec == 0 )
+      {
+         hc_localTime( timeFormat->dayEnd - 1, &edge );
+      }
+      if( edge.tm_mday != tm.tm_mday || edge.tm_hour != 23 || edge.tm_min != 59 || edge.tm_sec != 59 )
+      {
+         memcpy( date, timeFormat->date, sizeof( timeFormat->date ) );
+         strftime( time, 9, "%H:%M:%S", &tm );
+         timeFormat->dayEnd = timeFormat->dayStart;
+         return;
+      }
+   }
+
+   secondOfDay = seconds - timeFormat->dayStart;
+   hour   = ( int ) ( secondOfDay / 3600 );
+   minute = ( int ) ( secondOfDay / 60 % 60 );
+   second = ( int ) ( secondOfDay % 60 );
+
+   memcpy( date, timeFormat->date, sizeof( timeFormat->date ) );
+   time[ 0 ] = '0' + hour / 10;
+   time[ 1 ] = '0' + hour % 10;
+   time[ 2 ] = ':';
+   time[ 3 ] = '0' + minute / 10;
+   time[ 4 ] = '0' + minute % 10;
+   time[ 5 ] = ':';
+   time[ 6 ] = '0' + second / 10;
+   time[ 7 ] = '0' + second % 10;
+   time[ 8 ] = '\0';
+}
+
+static void hc_localTime( int64_t seconds, struct tm *tm )
+{
+   time_t value = ( time_t ) seconds;
+
+#if defined( _WIN32 ) || defined( _WIN64 )
+   localtime_s( tm, &value );
+#else
+   localtime_r( &value, tm );
+#endif
+}
+
+/* Move the parent directory ("..") to the first position if found */
+static void hc_listingParentFirst( Listing *listing, int parentIndex )
+{
+   if( parentIndex > 0 )
+   {
+      hc_listingMove( listing->orders[ SORT_UNSORTED ], parentIndex, 0 );
+   }
+}
+
+static Listing *hc_listingNew( void )
+{
+   Listing *listing = malloc( sizeof( Listing ) );
+   if( !listing )
+   {
+      fprintf( stderr, "Failed to allocate memory for Listing. \n" );
+      return NULL;
+   }
+
+   memset( listing, 0, sizeof( Listing ) );
+   listing->allocCount = 1;
+   listing->dirFd = - 1;
+   listing->refCount = 1;
+   listing->watch = - 1;
+   listing->serial = ( uint32_t ) SDL_AtomicAdd( &listingSerials, 1 ) + 1;
+
+   return listing;
+}
+
+/* Copy of a listing for a loader thread to work on while the panel keeps using the original:
+   columns, names and read order, with its own descriptor of the directory. NULL when out of memory. */
+static Listing *hc_listingCopy( const Listing *source )
+{
+   Listing *listing = hc_listingNew();
+   int capacity = NK_MAX( source->count, 1 );
+
+   if( !listing )
+   {
+      return NULL;
+   }
+
+   listing->names      = malloc( NK_MAX( source->namesSize, 1 ) );
+   listing->nameOffset = malloc( sizeof( uint32_t ) * capacity );
+   listing->size       = malloc( sizeof( int64_t ) * capacity );
+   listing->mtime      = malloc( sizeof( int64_t ) * capacity );
+   listing->mode       = malloc( sizeof( uint32_t ) * capacity );
+   listing->flags      = malloc( sizeof( uint8_t ) * capacity );
+   listing->orders[ SORT_UNSORTED ] = malloc( sizeof( uint32_t ) * capacity );
+   listing->allocCount += 7;
+   if( !listing->names || !listing->nameOffset || !listing->size || !listing->mtime || !listing->mode ||
+       !listing->flags || !listing->orders[ SORT_UNSORTED ] )
+   {
+      fprintf( stderr, "Memory allocation error.\n" );
+      hc_listingFree( listing );
+      return NULL;
+   }
+
+   memcpy( listing->names, source->names, source->namesSize );
+   memcpy( listing->nameOffset, source->nameOffset, sizeof( uint32_t ) * source->count );
+   memcpy( listing->size, source->size, sizeof( int64_t ) * source->count );
+   memcpy( listing->mtime, source->mtime, sizeof( int64_t ) * source->count );
+   memcpy( listing->mode, source->mode, sizeof( uint32_t ) * source->count );
+   memcpy( listing->flags, source->flags, sizeof( uint8_t ) * source->count );
+   memcpy( listing->orders[ SORT_UNSORTED ], source->orders[ SORT_UNSORTED ], sizeof( uint32_t ) * source->count );
+   listing->namesSize     = source->namesSize;
+   listing->namesCapacity = NK_MAX( source->namesSize, 1 );
+   listing->count         = source->count;
+   listing->capacity      = capacity;
+
+   hc_strncpy( listing->path, source->path );
+   listing->statThreads = source->statThreads;
+   listing->statBackend = source->statBackend;
+#if defined( __linux__ )
+   if( source->dirFd != - 1 )
+   {
+      listing->dirFd = fcntl( source->dirFd, F_DUPFD_CLOEXEC, 0 );
+   }
+#endif
+
+   return listing;
+}
+
+/* Takes over the order of `mode` built on a copy of the listing, together with the entries the
+   copy stat'ed for it and, for the collated modes, its keys. F when out of memory. */
+static nk_bool hc_listingAdopt( Listing *listing, Listing *sorted, int mode )
+{
+   Collation *collation = &sorted->collations[ mode ];
+   uint32_t *order;
+   nk_bool changed = F;
+   int i;
+
+   order = realloc( sorted->orders[ mode ], sizeof( uint32_t ) * listing->capacity );
+   if( !order )
+   {
+      return F;
+   }
+   sorted->orders[ mode ] = order;
+
+   if( collation->offset )
+   {
+      order = realloc( collation->offset, sizeof( uint32_t ) * listing->capacity );
+      if( !order )
+      {
+         return F;
+      }
+      collation->offset = order;
+
+      hc_collationDrop( listing, mode );
+      listing->collations[ mode ] = *collation;
+      memset( collation, 0, sizeof( Collation ) );
+      listing->allocCount += 2;
+   }
+
+   for( i = 0; i < listing->count; i++ )
+   {
+      if( !( listing->flags[ i ] & DIRLIST_LOADED ) && ( sorted->flags[ i ] & DIRLIST_LOADED ) )
+      {
+         hc_listingCount( listing, i, - 1 );
+         listing->size[ i ]  = sorted->size[ i ];
+         listing->mtime[ i ] = sorted->mtime[ i ];
+         listing->mode[ i ]  = sorted->mode[ i ];
+         listing->flags[ i ] = ( sorted->flags[ i ] & ~DIRLIST_SELECTED ) | ( listing->flags[ i ] & DIRLIST_SELECTED );
+         hc_listingCount( listing, i, 1 );
+         changed = T;
+      }
+   }
+   if( changed )
+   {
+      listing->version++;
+   }
+
+   listing->orders[ mode ] = sorted->orders[ mode ];
+   sorted->orders[ mode ] = NULL;
+   listing->allocCount++;
+
+   return T;
+}
+
+static const char *hc_listingName( const Listing *listing, int entry )
+{
+   return listing->names + listing->nameOffset[ entry ];
+}
+
+/* Permutation a panel in SORT_* mode shows. Never sorts: listings still being read and modes
+   not sorted yet show the read order, panels have missing modes sorted by hc_fetchSort. */
+static const uint32_t *hc_listingOrder( Listing *listing, int mode )
+{
+   return IIF( listing->orders[ mode ], listing->orders[ mode ], listing->orders[ SORT_UNSORTED ] );
+}
+
+/* Entry shown at a position */
+static int hc_listingEntry( Listing *listing, int mode, int position )
+{
+   return ( int ) hc_listingOrder( listing, mode )[ position ];
+}
+
+static const char *hc_listingNameAt( Listing *listing, int mode, int position )
+{
+   return hc_listingName( listing, hc_listingOrder( listing, mode )[ position ] );
+}
+
+/* Position an entry is shown at, - 1 when it is not in the listing */
+static int hc_listingPosition( Listing *listing, int mode, int entry )
+{
+   const uint32_t *order = hc_listingOrder( listing, mode );
+   int i;
+
+   for( i = 0; i < listing->count; i++ )
+   {
+      if( order[ i ] == ( uint32_t ) entry )
+      {
+         return i;
+      }
+   }
+   return - 1;
+}
+
+/* Appends an entry called name with empty columns, shown at the last position of every
+   permutation, and returns the entry, - 1 when out of memory. Columns and name pool double
+   whenever they are full. */
+static int hc_listingAppend( Listing *listing, const char *name )
+{
+   uint32_t length = ( uint32_t ) strlen( name ) + 1;
+   int sortMode;
+   int index;
+
+   if( listing->count >= listing->capacity )
+   {
+      int newCapacity = IIF( listing->capacity > 0, listing->capacity * 2, LISTING_INITIAL );
+      uint32_t *nameOffset = realloc( listing->nameOffset, sizeof( uint32_t ) * newCapacity );
+      int64_t  *size       = nameOffset ? realloc( listing->size, sizeof( int64_t ) * newCapacity ) : NULL;
+      int64_t  *mtime      = size ? realloc( listing->mtime, sizeof( int64_t ) * newCapacity ) : NULL;
+      uint32_t *mode       = mtime ? realloc( listing->mode, sizeof( uint32_t ) * newCapacity ) : NULL;
+      uint8_t  *flags      = mode ? realloc( listing->flags, sizeof( uint8_t ) * newCapacity ) : NULL;
+      uint32_t *order      = flags ? realloc( listing->orders[ SORT_UNSORTED ], sizeof( uint32_t ) * newCapacity ) : NULL;
+
+      /* columns that did move stay valid at their new address */
+      if( nameOffset ) listing->nameOffset = nameOffset;
+      if( size )       listing->size       = size;
+      if( mtime )      listing->mtime      = mtime;
+      if( mode )       listing->mode       = mode;
+      if( flags )      listing->flags      = flags;
+      if( !order )
+      {
+         fprintf( stderr, "Memory allocation error.\n" );
+         return - 1;
+      }
+      listing->orders[ SORT_UNSORTED ] = order;
+      listing->capacity = newCapacity;
+      listing->allocCount += 6;
+
+      /* a sorted permutation that cannot grow is dropped and sorted again when shown */
+      for( sortMode = 0; sortMode < SORT_MODES; sortMode++ )
+      {
+         if( sortMode != SORT_UNSORTED && listing->orders[ sortMode ] )
+         {
+            order = realloc( listing->orders[ sortMode ], sizeof( uint32_t ) * newCapacity );
+            if( !order )
+            {
+               free( listing->orders[ sortMode ] );
+            }
+            listing->orders[ sortMode ] = order;
+            listing->allocCount++;
+         }
+      }
+      for( sortMode = 0; sortMode < SORT_MODES; sortMode++ )
+      {
+         if( listing->collations[ sortMode ].offset )
+         {
+            order = realloc( listing->collations[ sortMode ].offset, sizeof( uint32_t ) * newCapacity );
+            if( order )
+            {
+               listing->collations[ sortMode ].offset = order;
+               listing->allocCount++;
+            }
+            else
+            {
+               hc_collationDrop( listing, sortMode );
+            }
+         }
+      }
+   }
+
+   if( listing->namesCapacity - listing->namesSize < length )
+   {
+      uint32_t newCapacity = IIF( listing->namesCapacity > 0, listing->namesCapacity, NAMES_INITIAL );
+      char *names;
+
+      while( newCapacity - listing->namesSize < length )
+      {
+         newCapacity *= 2;
+      }
+      names = realloc( listing->names, newCapacity );
+      if( !names )
+      {
+         fprintf( stderr, "Memory allocation error.\n" );
+         return - 1;
+      }
+      listing->names         = names;
+      listing->namesCapacity = newCapacity;
+      ++listing->allocCount;
+   }
+
+   index = listing->count++;
+   memcpy( listing->names + listing->namesSize, name, length );
+   listing->nameOffset[ index ] = listing->namesSize;
+   listing->namesSize += length;
+
+   listing->size[ index ]  = 0;
+   listing->mtime[ index ] = 0;
+   listing->mode[ index ]  = 0;
+   listing->flags[ index ] = 0;
+   hc_listingCount( listing, index, 1 );
+   listing->version++;
+   listing->edits++;
+   for( sortMode = 0; sortMode < SORT_MODES; sortMode++ )
+   {
+      if( listing->orders[ sortMode ] )
+      {
+         listing->orders[ sortMode ][ index ] = index;
+      }
+   }
+   for( sortMode = 0; sortMode < SORT_MODES; sortMode++ )
+   {
+      if( listing->collations[ sortMode ].offset && !hc_listingCollate( listing, sortMode, index ) )
+      {
+         hc_collationDrop( listing, sortMode );
+      }
+   }
+
+   return index;
+}
+
+/* Copies count entries of source, starting at entry first, to the end of the listing, optionally leaving out ".." */
+static nk_bool hc_listingAppendFrom( Listing *listing, const Listing *source, int first, int count, nk_bool skipParent )
+{
+   int i;
+
+   for( i = first; i < first + count; i++ )
+   {
+      const char *name = hc_listingName( source, i );
+      int index;
+
+      if( skipParent && strcmp( name, ".." ) == 0 )
+      {
+         continue;
+      }
+
+      index = hc_listingAppend( listing, name );
+      if( index == - 1 )
+      {
+         return F;
+      }
+      hc_listingCount( listing, index, - 1 );
+      listing->size[ index ]  = source->size[ i ];
+      listing->mtime[ index ] = source->mtime[ i ];
+      listing->mode[ index ]  = source->mode[ i ];
+      listing->flags[ index ] = source->flags[ i ];
+      hc_listingCount( listing, index, 1 );
+   }
+
+   return T;
+}
+
+/* Moves the entry shown at position from of a permutation to position to, shifting the
+   positions in between by one */
+static void hc_listingMove( uint32_t *order, int from, int to )
+{
+   uint32_t entry = order[ from ];
+
+   if( from < to )
+   {
+      memmove( &order[ from ], &order[ from + 1 ], sizeof( uint32_t ) * ( to - from ) );
+   }
+   else if( from > to )
+   {
+      memmove( &order[ to + 1 ], &order[ to ], sizeof( uint32_t ) * ( from - to ) );
+   }
+   order[ to ] = entry;
+}
+
+/* Removes an entry from the columns and every permutation; its name stays in the pool until
+   the listing is freed */
+static void hc_listingRemove( Listing *listing, int entry )
+{
+   int tail = listing->count - entry - 1;
+   int sortMode;
+   int i;
+
+   hc_listingCount( listing, entry, - 1 );
+   listing->version++;
+   listing->edits++;
+   memmove( &listing->nameOffset[ entry ], &listing->nameOffset[ entry + 1 ], sizeof( uint32_t ) * tail );
+   memmove( &listing->size[ entry ], &listing->size[ entry + 1 ], sizeof( int64_t ) * tail );
+   memmove( &listing->mtime[ entry ], &listing->mtime[ entry + 1 ], sizeof( int64_t ) * tail );
+   memmove( &listing->mode[ entry ], &listing->mode[ entry + 1 ], sizeof( uint32_t ) * tail );
+   memmove( &listing->flags[ entry ], &listing->flags[ entry + 1 ], sizeof( uint8_t ) * tail );
+   for( sortMode = 0; sortMode < SORT_MODES; sortMode++ )
+   {
+      if( listing->collations[ sortMode ].offset )
+      {
+         memmove( &listing->collations[ sortMode ].offset[ entry ], &listing->collations[ sortMode ].offset[ entry + 1 ], sizeof( uint32_t ) * tail );
+      }
+   }
+
+   for( sortMode = 0; sortMode < SORT_MODES; sortMode++ )
+   {
+      uint32_t *order = listing->orders[ sortMode ];
+      int count = 0;
+
+      if( !order )
+      {
+         continue;
+      }
+      for( i = 0; i < listing->count; i++ )
+      {
+         if( order[ i ] != ( uint32_t ) entry )
+         {
+            order[ count++ ] = order[ i ] - IIF( order[ i ] > ( uint32_t ) entry, 1, 0 );
+         }
+      }
+   }
+   --listing->count;
+}
+
+/* Builds the permutation of a SORT_* mode, on loader threads only. Sort keys are built once per
+   entry and sorted; the entries themselves never move, only 4 bytes per entry are written.
+   Sorting by time or size stats the entries a lazy listing has not loaded yet, the natural and locale sorts build their
+   keys once. Large name, natural and locale sorts use multikey quicksort,
+   which looks at each name byte about once instead of on every comparison; huge listings are
+   sorted in runs on the worker pool and merged. */
+static void hc_listingSort( Listing *listing, int mode )
+{
+   SortKey *keys;
+   SortKey *temp;
+   uint32_t *order;
+   nk_bool radix;
+   int threads;
+   int i;
+
+   listing->sorted = T;
+   if( mode == SORT_UNSORTED || listing->count == 0 )
+   {
+      return;
+   }
+
+   if( mode == SORT_TIME || mode == SORT_SIZE )
+   {
+      hc_listingLoadInfo( listing, SORT_UNSORTED, 0, listing->count );
+   }
+   if( hc_sortCollated( mode ) && !listing->collations[ mode ].offset && !hc_listingCollateAll( listing, mode ) )
+   {
+      fprintf( stderr, "Memory allocation error.\n" );
+      return;
+   }
+
+   order = listing->orders[ mode ];
+   if( !order )
+   {
+      order = malloc( sizeof( uint32_t ) * listing->capacity );
+      listing->allocCount++;
+   }
+   keys = malloc( sizeof( SortKey ) * listing->count );
+   temp = malloc( sizeof( SortKey ) * listing->count );
+   if( !order || !keys || !temp )
+   {
+      fprintf( stderr, "Memory allocation error.\n" );
+      if( order != listing->orders[ mode ] )
+      {
+         free( order );
+      }
+      free( keys );
+      free( temp );
+      return;
+   }
+
+   radix   = ( mode == SORT_NAME || hc_sortCollated( mode ) ) && listing->count >= hc_envInt( "HC_RADIX_THRESHOLD", RADIX_THRESHOLD );
+   threads = IIF( listing->count >= SORT_PARALLEL, hc_envInt( "HC_SORT_THREADS", SDL_GetCPUCount() ), 1 );
+   if( threads > 1 )
+   {
+      hc_sortKeysParallel( listing, mode, radix, keys, temp, listing->count, threads );
+   }
+   else
+   {
+      for( i = 0; i < listing->count; i++ )
+      {
+         hc_sortKeyMake( listing, mode, i, &keys[ i ] );
+      }
+      if( radix )
+      {
+         hc_sortKeysByName( listing, mode, keys, temp, listing->count );
+      }
+      else
+      {
+         hc_sortKeys( listing, mode, keys, temp, listing->count );
+      }
+   }
+
+   for( i = 0; i < listing->count; i++ )
+   {
+      order[ i ] = keys[ i ].index;
+   }
+   listing->orders[ mode ] = order;
+
+   free( keys );
+   free( temp );
+}
+
+/* Extension of a file name without the dot, "" when there is none; the leading dot of a
+   hidden file does not start an extension */
+static const char *hc_nameExtension( const char *name )
+{
+   const char *dot = strrchr( name, '.' );
+
+   return IIF( dot && dot != name, dot + 1, name + strlen( name ) );
+}
+
+/* Modes that compare keys computed from the names rather than the names themselves */
+static nk_bool hc_sortCollated( int mode )
+{
+   return mode == SORT_NATURAL || mode == SORT_LOCALE;
+}
+
+/* Writes the sort key of a name for a collated mode to key and returns its length. When that
+   is room or more, key did not fit and the caller retries with length + 1 bytes of room.
+   Natural keys turn every digit run into a '0', its length without leading zeros and those
+   digits, so that comparing keys bytewise puts frame_2 before frame_10; runs of more than
+   255 digits compare by their first 255. Locale keys come from strxfrm, whose byte order is
+   the strcoll order of the names. */
+static size_t hc_collationKey( int mode, const char *name, char *key, size_t room )
+{
+   size_t length = 0;
+
+   if( mode == SORT_LOCALE )
+   {
+      return strxfrm( key, name, room );
+   }
+
+   if( room < strlen( name ) * 3 + 1 )
+   {
+      return strlen( name ) * 3 + 1;
+   }
+
+   while( *name )
+   {
+      if( *name >= '0' && *name <= '9' )
+      {
+         const char *digits;
+         size_t count;
+
+         while( name[ 0 ] == '0' && name[ 1 ] >= '0' && name[ 1 ] <= '9' )
+         {
+            ++name;
+         }
+         for( digits = name; *name >= '0' && *name <= '9'; name++ )
+         {
+         }
+         count = ( size_t ) ( name - digits );
+
+         key[ length++ ] = '0';
+         key[ length++ ] = ( char ) NK_MIN( count, 255 );
+         memcpy( key + length, digits, count );
+         length += count;
+      }
+      else
+      {
+         key[ length++ ] = *name++;
+      }
+   }
+   key[ length ] = '\0';
+
+   return length;
+}
+
+/* Adds the sort key of an entry to the key pool of a collated mode, which doubles when full */
+static nk_bool hc_listingCollate( Listing *listing, int mode, int entry )
+{
+   Collation *collation = &listing->collations[ mode ];
+   const char *name = hc_listingName( listing, entry );
+   size_t length;
+
+   while( ( length = hc_collationKey( mode, name, IIF( collation->keys, collation->keys + collation->size, NULL ),
+                                      collation->capacity - collation->size ) ) >= collation->capacity - collation->size )
+   {
+      uint32_t newCapacity = IIF( collation->capacity > 0, collation->capacity, NAMES_INITIAL );
+      char *keys;
+
+      while( newCapacity - collation->size <= length )
+      {
+         newCapacity *= 2;
+      }
+      keys = realloc( collation->keys, newCapacity );
+      if( !keys )
+      {
+         return F;
+      }
+      collation->keys     = keys;
+      collation->capacity = newCapacity;
+      ++listing->allocCount;
+   }
+
+   collation->offset[ entry ] = collation->size;
+   collation->size += ( uint32_t ) length + 1;
+
+   return T;
+}
+
+/* Builds the sort keys of all entries for a collated mode; new entries get theirs from hc_listingAppend */
+static nk_bool hc_listingCollateAll( Listing *listing, int mode )
+{
+   Collation *collation = &listing->collations[ mode ];
+   int i;
+
+   collation->offset = malloc( sizeof( uint32_t ) * NK_MAX( listing->capacity, 1 ) );
+   if( !collation->offset )
+   {
+      return F;
+   }
+   ++listing->allocCount;
+
+   for( i = 0; i < listing->count; i++ )
+   {
+      if( !hc_listingCollate( listing, mode, i ) )
+      {
+         hc_collationDrop( listing, mode );
+         return F;
+      }
+   }
+   return T;
+}
+
+/* Frees the sort keys of a collated mode together with the order built from them */
+static void hc_collationDrop( Listing *listing, int mode )
+{
+   free( listing->collations[ mode ].keys );
+   free( listing->collations[ mode ].offset );
+   free( listing->orders[ mode ] );
+   memset( &listing->collations[ mode ], 0, sizeof( Collation ) );
+   listing->orders[ mode ] = NULL;
+}
+
+/* String a SORT_* mode compares for an entry */
+static const char *hc_sortField( const Listing *listing, int mode, int entry )
+{
+   if( hc_sortCollated( mode ) )
+   {
+      return listing->collations[ mode ].keys + listing->collations[ mode ].offset[ entry ];
+   }
+   if( mode == SORT_EXTENSION )
+   {
+      return hc_nameExtension( hc_listingName( listing, entry ) );
+   }
+   return hc_listingName( listing, entry );
+}
+
+static void hc_sortKeyMake( const Listing *listing, int mode, int entry, SortKey *key )
+{
+   const char *name = hc_listingName( listing, entry );
+   const char *field = name;
+   int flags = listing->flags[ entry ];
+
+   if( strcmp( name, ".." ) == 0 )
+   {
+      key->rank = SORT_RANK_PARENT;
+   }
+   else
+   {
+      key->rank = IIF( flags & DIRLIST_DIRECTORY, SORT_RANK_DIRECTORY, SORT_RANK_FILE ) + IIF( flags & DIRLIST_HIDDEN, 1, 0 );
+   }
+
+   key->index = entry;
+   key->named = F;
+
+   if( mode == SORT_TIME )
+   {
+      /* flipping the sign bit orders signed times as unsigned, inverting puts the newest first */
+      key->prefix = ~( ( uint64_t ) listing->mtime[ entry ] ^ 0x8000000000000000ULL );
+      return;
+   }
+   if( mode == SORT_SIZE && !( flags & DIRLIST_DIRECTORY ) )
+   {
+      key->prefix = ~( uint64_t ) listing->size[ entry ];
+      return;
+   }
+   /* the others compare a string: the collation key, the extension of a file or the name */
+   if( hc_sortCollated( mode ) || ( mode == SORT_EXTENSION && !( flags & DIRLIST_DIRECTORY ) ) )
+   {
+      field = hc_sortField( listing, mode, entry );
+   }
+   else
+   {
+      key->named = T;
+   }
+
+   key->prefix = hc_nameWord( field );
+}
+
+static int hc_sortKeyCompare( const Listing *listing, int mode, const SortKey *A, const SortKey *B )
+{
+   const char *nameA;
+   const char *nameB;
+
+   if( A->rank != B->rank )
+   {
+      return IIF( A->rank < B->rank, - 1, 1 );
+   }
+   if( A->prefix != B->prefix )
+   {
+      return IIF( A->prefix < B->prefix, - 1, 1 );
+   }
+
+   nameA = hc_listingName( listing, A->index );
+   nameB = hc_listingName( listing, B->index );
+   if( A->named )
+   {
+      /* equal prefixes ending in a NUL are equal names */
+      if( ( A->prefix & 0xFF ) == 0 )
+      {
+         return 0;
+      }
+      return strcmp( nameA + 8, nameB + 8 );
+   }
+
+   /* equal sort fields fall back to the name */
+   if( ( mode == SORT_EXTENSION || hc_sortCollated( mode ) ) && ( A->prefix & 0xFF ) != 0 )
+   {
+      int result = strcmp( hc_sortField( listing, mode, A->index ) + 8, hc_sortField( listing, mode, B->index ) + 8 );
+      if( result != 0 )
+      {
+         return result;
+      }
+   }
+   return strcmp( nameA, nameB );
+}
+
+/* Stable bottom-up merge sort of count sort keys; temp has room for count keys */
+static void hc_sortKeys( const Listing *listing, int mode, SortKey *keys, SortKey *temp, int count )
+{
+   SortKey *source = keys;
+   SortKey *target = temp;
+   int width;
+
+   for( width = 1; width < count; width *= 2 )
+   {
+      int first;
+
+      for( first = 0; first < count; first += 2 * width )
+      {
+         hc_mergeKeys( listing, mode, source, target, first, NK_MIN( first + width, count ), NK_MIN( first + 2 * width, count ) );
+      }
+
+      {
+         SortKey *swap = source;
+         source = target;
+         target = swap;
+      }
+   }
+
+   if( source != keys )
+   {
+      memcpy( keys, source, sizeof( SortKey ) * count );
+   }
+}
+
+/* Merges the sorted runs source[ first .. middle ) and source[ middle .. last ) into the same
+   range of target, keeping equal keys in run order */
+static void hc_mergeKeys( const Listing *listing, int mode, const SortKey *source, SortKey *target, int first, int middle, int last )
+{
+   int a = first, b = middle, k = first;
+
+   while( a < middle && b < last )
+   {
+      if( hc_sortKeyCompare( listing, mode, &source[ b ], &source[ a ] ) < 0 )
+      {
+         target[ k++ ] = source[ b++ ];
+      }
+      else
+      {
+         target[ k++ ] = source[ a++ ];
+      }
+   }
+   while( a < middle )
+   {
+      target[ k++ ] = source[ a++ ];
+   }
+   while( b < last )
+   {
+      target[ k++ ] = source[ b++ ];
+   }
+}
+
+/* Builds and sorts the keys of count entries with up to threads workers: one run per worker,
+   then log2( runs ) merge rounds, each merging its pairs of runs in parallel */
+static void hc_sortKeysParallel( const Listing *listing, int mode, nk_bool radix, SortKey *keys, SortKey *temp, int count, int threads )
+{
+   SortJob job;
+   int run;
+
+   job.listing = listing;
+   job.mode    = mode;
+   job.radix   = radix;
+   job.keys    = keys;
+   job.temp    = temp;
+   job.count   = count;
+   job.runs    = NK_CLAMP( 1, threads, POOL_MAX_THREADS );
+   job.merging = F;
+   for( run = 0; run <= job.runs; run++ )
+   {
+      job.bounds[ run ] = ( int ) ( ( int64_t ) count * run / job.runs );
+   }
+   SDL_AtomicSet( &job.next, 0 );
+
+   hc_poolRun( job.runs, hc_sortJob, &job );
+
+   job.merging = T;
+   while( job.runs > 1 )
+   {
+      SortKey *swap;
+      int pairs = ( job.runs + 1 ) / 2;
+
+      SDL_AtomicSet( &job.next, 0 );
+      hc_poolRun( pairs, hc_sortJob, &job );
+
+      /* the merged runs start where every other run started */
+      for( run = 0; run < pairs; run++ )
+      {
+         job.bounds[ run ] = job.bounds[ 2 * run ];
+      }
+      job.bounds[ pairs ] = count;
+      job.runs = pairs;
+
+      swap = job.keys;
+      job.keys = job.temp;
+      job.temp = swap;
+   }
+
+   if( job.keys != keys )
+   {
+      memcpy( keys, job.keys, sizeof( SortKey ) * count );
+   }
+}
+
+static void hc_sortJob( void *arg )
+{
+   SortJob *job = arg;
+   int item;
+   int i;
+
+   if( job->merging )
+   {
+      while( ( item = SDL_AtomicAdd( &job->next, 1 ) ) < ( job->runs + 1 ) / 2 )
+      {
+         int first  = job->bounds[ 2 * item ];
+         int middle = job->bounds[ NK_MIN( 2 * item + 1, job->runs ) ];
+         int last   = job->bounds[ NK_MIN( 2 * item + 2, job->runs ) ];
+
+         hc_mergeKeys( job->listing, job->mode, job->keys, job->temp, first, middle, last );
+      }
+      return;
+   }
+
+   while( ( item = SDL_AtomicAdd( &job->next, 1 ) ) < job->runs )
+   {
+      int first = job->bounds[ item ];
+      int count = job->bounds[ item + 1 ] - first;
+      SortKey *keys = job->keys + first;
+
+      for( i = 0; i < count; i++ )
+      {
+         hc_sortKeyMake( job->listing, job->mode, first + i, &keys[ i ] );
+      }
+
+      if( job->radix )
+      {
+         hc_sortKeysByName( job->listing, job->mode, keys, job->temp + first, count );
+
+         /* the multikey quicksort leaves later bytes in the prefixes the merge compares */
+         for( i = 0; i < count; i++ )
+         {
+            keys[ i ].prefix = hc_nameWord( hc_sortField( job->listing, job->mode, keys[ i ].index ) );
+         }
+      }
+      else
+      {
+         hc_sortKeys( job->listing, job->mode, keys, job->temp + first, count );
+      }
+   }
+}
+
+/* Next 8 bytes of a name, big endian, zero padded past its end */
+static uint64_t hc_nameWord( const char *name )
+{
+   const unsigned char *bytes = ( const unsigned char * ) name;
+   uint64_t word = 0;
+   int i;
+
+   for( i = 0; i < 8; i++ )
+   {
+      word <<= 8;
+      if( *bytes )
+      {
+         word |= *bytes++;
+      }
+   }
+   return word;
+}
+
+/* Name or natural sort keys in hc_sortKeyCompare order: a counting pass splits them into their
+   groups, then every group is sorted by its strings with hc_sortKeysRadix */
+static void hc_sortKeysByName( const Listing *listing, int mode, SortKey *keys, SortKey *temp, int count )
+{
+   int start[ SORT_RANK_HIDDEN_FILE + 2 ] = { 0 };
+   int next[ SORT_RANK_HIDDEN_FILE + 1 ];
+   int rank;
+   int i;
+
+   for( i = 0; i < count; i++ )
+   {
+      ++start[ keys[ i ].rank + 1 ];
+   }
+   for( rank = 0; rank <= SORT_RANK_HIDDEN_FILE; rank++ )
+   {
+      start[ rank + 1 ] += start[ rank ];
+      next[ rank ] = start[ rank ];
+   }
+   for( i = 0; i < count; i++ )
+   {
+      temp[ next[ keys[ i ].rank ]++ ] = keys[ i ];
+   }
+   memcpy( keys, temp, sizeof( SortKey ) * count );
+
+   for( rank = 0; rank <= SORT_RANK_HIDDEN_FILE; rank++ )
+   {
+      hc_sortKeysRadix( listing, mode, keys + start[ rank ], start[ rank + 1 ] - start[ rank ], 0 );
+   }
+}
+
+/* Multikey quicksort of keys whose strings share their first depth bytes and whose prefix holds
+   the 8 bytes after them. The keys are split three ways around a pivot prefix; only the equal
+   part goes on to the next 8 bytes, read once per key from the pool, and it stops where the
+   strings end. Long common prefixes, as in timestamped names, cost one pass per 8 bytes. */
+static void hc_sortKeysRadix( const Listing *listing, int mode, SortKey *keys, int count, int depth )
+{
+   SortKey swap;
+   int i;
+
+   while( count > RADIX_INSERTION )
+   {
+      uint64_t a = keys[ 0 ].prefix;
+      uint64_t b = keys[ count / 2 ].prefix;
+      uint64_t c = keys[ count - 1 ].prefix;
+      uint64_t pivot = IIF( a < b, IIF( b < c, b, IIF( a < c, c, a ) ), IIF( a < c, a, IIF( b < c, c, b ) ) );
+      int less = 0;
+      int greater = count;
+
+      i = 0;
+      while( i < greater )
+      {
+         if( keys[ i ].prefix < pivot )
+         {
+            swap = keys[ less ]; keys[ less++ ] = keys[ i ]; keys[ i++ ] = swap;
+         }
+         else if( keys[ i ].prefix > pivot )
+         {
+            swap = keys[ --greater ]; keys[ greater ] = keys[ i ]; keys[ i ] = swap;
+         }
+         else
+         {
+            ++i;
+         }
+      }
+
+      if( ( pivot & 0xFF ) != 0 && greater - less > 1 )
+      {
+         for( i = less; i < greater; i++ )
+         {
+            keys[ i ].prefix = hc_nameWord( hc_sortField( listing, mode, keys[ i ].index ) + depth + 8 );
+         }
+         hc_sortKeysRadix( listing, mode, keys + less, greater - less, depth + 8 );
+      }
+      else if( greater - less > 1 )
+      {
+         /* equal strings: names in a directory are unique, collation keys of different names may tie */
+         hc_insertKeys( listing, mode, keys + less, greater - less, depth );
+      }
+
+      /* recurse into the smaller side and go on with the larger one */
+      if( less < count - greater )
+      {
+         hc_sortKeysRadix( listing, mode, keys, less, depth );
+         keys  += greater;
+         count -= greater;
+      }
+      else
+      {
+         hc_sortKeysRadix( listing, mode, keys + greater, count - greater, depth );
+         count = less;
+      }
+   }
+
+   hc_insertKeys( listing, mode, keys, count, depth );
+}
+
+/* Insertion sort of the few keys hc_sortKeysRadix leaves over */
+static void hc_insertKeys( const Listing *listing, int mode, SortKey *keys, int count, int depth )
+{
+   SortKey key;
+   int i, j;
+
+   for( i = 1; i < count; i++ )
+   {
+      key = keys[ i ];
+      for( j = i; j > 0 && hc_radixCompare( listing, mode, &key, &keys[ j - 1 ], depth ) < 0; j-- )
+      {
+         keys[ j ] = keys[ j - 1 ];
+      }
+      keys[ j ] = key;
+   }
+}
+
+static int hc_radixCompare( const Listing *listing, int mode, const SortKey *A, const SortKey *B, int depth )
+{
+   int result = 0;
+
+   if( A->prefix != B->prefix )
+   {
+      return IIF( A->prefix < B->prefix, - 1, 1 );
+   }
+   if( ( A->prefix & 0xFF ) != 0 )
+   {
+      result = strcmp( hc_sortField( listing, mode, A->index ) + depth + 8, hc_sortField( listing, mode, B->index ) + depth + 8 );
+   }
+   if( result == 0 && mode != SORT_NAME )
+   {
+      result = strcmp( hc_listingName( listing, A->index ), hc_listingName( listing, B->index ) );
+   }
+   return result;
+}
+
+static void hc_listingFree( Listing *listing )
+{
+   int i;
+
+   if( listing )
+   {
+#if !defined( _WIN32 ) && !defined( _WIN64 )
+      if( listing->dirFd != - 1 )
+      {
+         close( listing->dirFd );
+      }
+#endif
+      if( listing->watch != - 1 )
+      {
+         hc_watchRelease( listing->watch );
+      }
+      free( listing->names );
+      free( listing->nameOffset );
+      free( listing->size );
+      free( listing->mtime );
+      free( listing->mode );
+      free( listing->flags );
+      for( i = 0; i < SORT_MODES; i++ )
+      {
+         free( listing->orders[ i ] );
+      }
+      for( i = 0; i < SORT_MODES; i++ )
+      {
+         free( listing->collations[ i ].keys );
+         free( listing->collations[ i ].offset );
+      }
+      free( listing );
+   }
+}
+
+/* Drops one reference; the last one takes the listing out of the cache and frees it */
+static void hc_listingRelease( Listing *listing )
+{
+   if( !listing )
+   {
+      return;
+   }
+
+   if( listingCache.mutex )
+   {
+      SDL_LockMutex( listingCache.mutex );
+   }
+
+   if( --listing->refCount > 0 )
+   {
+      listing = NULL;
+   }
+   else if( listing->cacheEntry )
+   {
+      hc_cacheRemove( listing->cacheEntry );
+   }
+
+   if( listingCache.mutex )
+   {
+      SDL_UnlockMutex( listingCache.mutex );
+   }
+
+   hc_listingFree( listing );
+}
+
+/* Stats the entries shown at positions [ first, last ) in a SORT_* mode that were listed by name only */
+static void hc_listingLoadInfo( Listing *listing, int mode, int first, int last )
+{
+#if defined( _WIN32 ) || defined( _WIN64 )
+   NK_UNUSED( listing );
+   NK_UNUSED( mode );
+   NK_UNUSED( first );
+   NK_UNUSED( last );
+#else
+   const uint32_t *order;
+   int i;
+
+   first = NK_MAX( first, 0 );
+   last  = NK_MIN( last, listing->count );
+   if( first >= last )
+   {
+      return;
+   }
+
+   order = hc_listingOrder( listing, mode );
+   while( first < last && ( listing->flags[ order[ first ] ] & DIRLIST_LOADED ) )
+   {
+      ++first;
+   }
+   while( last > first && ( listing->flags[ order[ last - 1 ] ] & DIRLIST_LOADED ) )
+   {
+      --last;
+   }
+   if( first == last )
+   {
+      return;
+   }
+
+   /* the workers change the columns in between, their widths are counted again afterwards */
+   for( i = first; i < last; i++ )
+   {
+      hc_listingCount( listing, order[ i ], - 1 );
+   }
+   hc_listingStat( listing, order, first, last, listing->statThreads );
+
+   /* failed entries keep the name-only columns and are not retried on every frame */
+   for( i = first; i < last; i++ )
+   {
+      listing->flags[ order[ i ] ] |= DIRLIST_LOADED;
+      hc_listingCount( listing, order[ i ], 1 );
+   }
+   listing->version++;
+#endif
+}
+
+#if !defined( _WIN32 ) && !defined( _WIN64 )
+/* Stats the not yet loaded entries at positions [ first, last ) of order, fanned out over the worker pool when threads > 1.
+   Entries whose stat fails stay unloaded. */
+static void hc_listingStat( Listing *listing, const uint32_t *order, int first, int last, int threads )
+{
+   StatJob job;
+
+#if defined( HC_HAVE_URING )
+   if( listing->statBackend == STAT_BACKEND_URING && listing->dirFd != - 1 && hc_listingStatUring( listing, order, first, last ) )
+   {
+      return;
+   }
+#endif
+
+   if( threads <= 1 || last - first <= STAT_CHUNK )
+   {
+      hc_listingStatRange( listing, order, first, last );
+      return;
+   }
+
+   job.listing = listing;
+   job.order   = order;
+   job.first   = first;
+   job.last    = last;
+   SDL_AtomicSet( &job.next, 0 );
+
+   hc_poolRun( NK_MIN( threads, ( last - first + STAT_CHUNK - 1 ) / STAT_CHUNK ), hc_statJob, &job );
+}
+
+static void hc_listingStatRange( Listing *listing, const uint32_t *order, int first, int last )
+{
+   struct stat fileInfo;
+   int i;
+
+   for( i = first; i < last; i++ )
+   {
+      int entry = order[ i ];
+      const char *name = hc_listingName( listing, entry );
+      int result;
+
+      if( listing->flags[ entry ] & DIRLIST_LOADED )
+      {
+         continue;
+      }
+
+      if( listing->dirFd != - 1 )
+      {
+         result = fstatat( listing->dirFd, name, &fileInfo, 0 );
+      }
+      else
+      {
+         char fullPath[ PATH_MAX ];
+         if( snprintf( fullPath, sizeof( fullPath ), "%s/%s", listing->path, name ) >= ( int ) sizeof( fullPath ) )
+         {
+            result = - 1;
+         }
+         else
+         {
+            result = stat( fullPath, &fileInfo );
+         }
+      }
+
+      if( result == 0 )
+      {
+         hc_listingFill( listing, entry, &fileInfo );
+      }
+   }
+}
+
+static void hc_statJob( void *arg )
+{
+   StatJob *job = arg;
+   int begin;
+
+   while( ( begin = job->first + SDL_AtomicAdd( &job->next, STAT_CHUNK ) ) < job->last )
+   {
+      hc_listingStatRange( job->listing, job->order, begin, NK_MIN( begin + STAT_CHUNK, job->last ) );
+   }
+}
+
+#if defined( HC_HAVE_URING )
+/* Stats [ first, last ) with IORING_OP_STATX relative to the directory descriptor, keeping up to
+   URING_DEPTH requests in flight and reaping completions while new ones are queued.
+   Returns F when io_uring is not usable, leaving the remaining entries to the synchronous path.
+   Every submitted request is reaped before returning, as the kernel writes into `results`. */
+static nk_bool hc_listingStatUring( Listing *listing, const uint32_t *order, int first, int last )
+{
+   static SDL_atomic_t unavailable;
+
+   URing ring;
+   struct statx *results;
+   int *slotItem;
+   int *freeSlots;
+   int freeCount = 0;
+   int queued = 0;     /* in the submission ring, not yet taken by the kernel */
+   int inFlight = 0;   /* submitted and not reaped yet */
+   int next = first;
+   nk_bool supported = T;
+   nk_bool stopped = F;
+   int i;
+
+   if( SDL_AtomicGet( &unavailable ) )
+   {
+      return F;
+   }
+
+   while( next < last && ( listing->flags[ order[ next ] ] & DIRLIST_LOADED ) )
+   {
+      ++next;
+   }
+   if( next >= last )
+   {
+      return T;
+   }
+
+   if( !hc_uringOpen( &ring, URING_DEPTH ) )
+   {
+      if( SDL_AtomicCAS( &unavailable, 0, 1 ) )
+      {
+         fprintf( stderr, "io_uring is not available, using synchronous stat.\n" );
+      }
+      return F;
+   }
+
+   results   = malloc( sizeof( struct statx ) * URING_DEPTH );
+   slotItem  = malloc( sizeof( int ) * URING_DEPTH );
+   freeSlots = malloc( sizeof( int ) * URING_DEPTH );
+   if( !results || !slotItem || !freeSlots )
+   {
+      free( results );
+      free( slotItem );
+      free( freeSlots );
+      hc_uringClose( &ring );
+      return F;
+   }
+
+   for( i = URING_DEPTH - 1; i >= 0; i-- )
+   {
+      freeSlots[ freeCount++ ] = i;
+   }
+
+   for( ;; )
+   {
+      unsigned tail = *ring.sqTail;
+      unsigned head;
+      int result;
+
+      /* queue as many requests as there are free slots, unless giving up */
+      while( supported && !stopped && next < last && freeCount > 0 )
+      {
+         struct io_uring_sqe *sqe;
+         int entry = order[ next ];
+         int slot;
+
+         if( listing->flags[ entry ] & DIRLIST_LOADED )
+         {
+            ++next;
+            continue;
+         }
+
+         slot = freeSlots[ --freeCount ];
+         slotItem[ slot ] = entry;
+
+         sqe = &ring.sqes[ tail & *ring.sqMask ];
+         memset( sqe, 0, sizeof( *sqe ) );
+         sqe->opcode      = IORING_OP_STATX;
+         sqe->fd          = listing->dirFd;
+         sqe->addr        = ( uint64_t ) ( uintptr_t ) hc_listingName( listing, entry );
+         sqe->len         = STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME;
+         sqe->off         = ( uint64_t ) ( uintptr_t ) &results[ slot ];
+         sqe->statx_flags = 0;
+         sqe->user_data   = ( uint64_t ) slot;
+         ring.sqArray[ tail & *ring.sqMask ] = tail & *ring.sqMask;
+
+         ++tail;
+         ++queued;
+         ++next;
+      }
+      __atomic_store_n( ring.sqTail, tail, __ATOMIC_RELEASE );
+
+      if( stopped || !supported )
+      {
+         /* requests still queued are never handed to the kernel; wait for the others only */
+         queued = 0;
+      }
+      if( inFlight + queued == 0 )
+      {
+         break;
+      }
+
+      /* the kernel skips the wait when it takes fewer requests than offered, so this only
+         blocks while something is in flight */
+      result = syscall( __NR_io_uring_enter, ring.ringFd, queued, 1, IORING_ENTER_GETEVENTS, NULL, 0 );
+      if( result < 0 )
+      {
+         /* interrupted, or out of resources until completions are reaped: try again */
+         if( errno != EINTR && !( ( errno == EAGAIN || errno == EBUSY ) && inFlight > 0 ) )
+         {
+            if( stopped )
+            {
+               /* completions can no longer be waited for; the buffers stay with the kernel */
+               fprintf( stderr, "io_uring_enter failed: %s\n", strerror( errno ) );
+               free( slotItem );
+               free( freeSlots );
+               hc_uringClose( &ring );
+               return F;
+            }
+            stopped = T;
+         }
+      }
+      else
+      {
+         queued   -= result;
+         inFlight += result;
+      }
+
+      /* reap everything that has completed so far */
+      head = *ring.cqHead;
+      while( head != __atomic_load_n( ring.cqTail, __ATOMIC_ACQUIRE ) )
+      {
+         struct io_uring_cqe *cqe = &ring.cqes[ head & *ring.cqMask ];
+         int slot = ( int ) cqe->user_data;
+
+         if( cqe->res == - EINVAL || cqe->res == - EOPNOTSUPP )
+         {
+            /* kernel without IORING_OP_STATX */
+            supported = F;
+         }
+         else if( cqe->res == 0 )
+         {
+            struct stat fileInfo;
+            memset( &fileInfo, 0, sizeof( fileInfo ) );
+            fileInfo.st_mode  = results[ slot ].stx_mode;
+            fileInfo.st_size  = results[ slot ].stx_size;
+            fileInfo.st_mtime = results[ slot ].stx_mtime.tv_sec;
+
+            hc_listingFill( listing, slotItem[ slot ], &fileInfo );
+         }
+
+         freeSlots[ freeCount++ ] = slot;
+         --inFlight;
+         ++head;
+      }
+      __atomic_store_n( ring.cqHead, head, __ATOMIC_RELEASE );
+   }
+
+   free( results );
+   free( slotItem );
+   free( freeSlots );
+   hc_uringClose( &ring );
+
+   if( !supported )
+   {
+      if( SDL_AtomicCAS( &unavailable, 0, 1 ) )
+      {
+         fprintf( stderr, "io_uring statx is not supported, using synchronous stat.\n" );
+      }
+      return F;
+   }
+
+   return !stopped;
+}
+
+static nk_bool hc_uringOpen( URing *ring, unsigned entries )
+{
+   struct io_uring_params params;
+
+   memset( ring, 0, sizeof( URing ) );
+   memset( &params, 0, sizeof( params ) );
+
+   ring->ringFd = syscall( __NR_io_uring_setup, entries, &params );
+   if( ring->ringFd < 0 )
+   {
+      return F;
+   }
+
+   ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+   ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe );
+   ring->sqesSize   = params.sq_entries * sizeof( struct io_uring_sqe );
+
+   if( params.features & IORING_FEAT_SINGLE_MMAP )
+   {
+      ring->sqRingSize = ring->cqRingSize = NK_MAX( ring->sqRingSize, ring->cqRingSize );
+   }
+
+   ring->sqRing = mmap( NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ringFd, IORING_OFF_SQ_RING );
+   if( ring->sqRing == MAP_FAILED )
+   {
+      close( ring->ringFd );
+      return F;
+   }
+
+   if( params.features & IORING_FEAT_SINGLE_MMAP )
+   {
+      ring->cqRing = ring->sqRing;
+   }
+   else
+   {
+      ring->cqRing = mmap( NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ringFd, IORING_OFF_CQ_RING );
+      if( ring->cqRing == MAP_FAILED )
+      {
+         munmap( ring->sqRing, ring->sqRingSize );
+         close( ring->ringFd );
+         return F;
+      }
+   }
+
+   ring->sqes = mmap( NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ringFd, IORING_OFF_SQES );
+   if( ring->sqes == MAP_FAILED )
+   {
+      if( ring->cqRing != ring->sqRing )
+      {
+         munmap( ring->cqRing, ring->cqRingSize );
+      }
+      munmap( ring->sqRing, ring->sqRingSize );
+      close( ring->ringFd );
+      return F;
+   }
+
+   ring->sqHead  = ( unsigned * ) ( ( char * ) ring->sqRing + params.sq_off.head );
+   ring->sqTail  = ( unsigned * ) ( ( char * ) ring->sqRing + params.sq_off.tail );
+   ring->sqMask  = ( unsigned * ) ( ( char * ) ring->sqRing + params.sq_off.ring_mask );
+   ring->sqArray = ( unsigned * ) ( ( char * ) ring->sqRing + params.sq_off.array );
+   ring->cqHead  = ( unsigned * ) ( ( char * ) ring->cqRing + params.cq_off.head );
+   ring->cqTail  = ( unsigned * ) ( ( char * ) ring->cqRing + params.cq_off.tail );
+   ring->cqMask  = ( unsigned * ) ( ( char * ) ring->cqRing + params.cq_off.ring_mask );
+   ring->cqes    = ( struct io_uring_cqe * ) ( ( char * ) ring->cqRing + params.cq_off.cqes );
+
+   return T;
+}
+
+static void hc_uringClose( URing *ring )
+{
+   munmap( ring->sqes, ring->sqesSize );
+   if( ring->cqRing != ring->sqRing )
+   {
+      munmap( ring->cqRing, ring->cqRingSize );
+   }
+   munmap( ring->sqRing, ring->sqRingSize );
+   close( ring->ringFd );
+}
+#endif
+
+/* Removes the entries a parallel stat could not load, as the sequential path skips them.
+   Called before the listing is sorted, so only the read order is there to reset. */
+static void hc_listingDropUnloaded( Listing *listing, int *parentIndex )
+{
+   int i, count = 0;
+
+   *parentIndex = - 1;
+   for( i = 0; i < listing->count; i++ )
+   {
+      if( !( listing->flags[ i ] & DIRLIST_LOADED ) )
+      {
+         fprintf( stderr, "Error getting file info: %s\n", hc_listingName( listing, i ) );
+         continue;
+      }
+
+      if( strcmp( hc_listingName( listing, i ), ".." ) == 0 )
+      {
+         *parentIndex = count;
+      }
+
+      if( count != i )
+      {
+         listing->nameOffset[ count ] = listing->nameOffset[ i ];
+         listing->size[ count ]       = listing->size[ i ];
+         listing->mtime[ count ]      = listing->mtime[ i ];
+         listing->mode[ count ]       = listing->mode[ i ];
+         listing->flags[ count ]      = listing->flags[ i ];
+      }
+      listing->orders[ SORT_UNSORTED ][ count ] = count;
+      ++count;
+   }
+   listing->count = count;
+}
+#endif
+
+/* Number of stat workers for a directory, taken from HC_STAT_THREADS.
+   The variable holds comma separated "path=threads" pairs and an optional bare default,
+   e.g. "4,/mnt/nfs=16,/media/fuse=8"; the longest matching path wins. */
+static int hc_statThreads( const char *path )
+{
+   const char *config = getenv( "HC_STAT_THREADS" );
+   int threads = 1;
+   size_t longestPrefix = 0;
+
+   while( config && *config )
+   {
+      const char *end    = strchr( config, ',' );
+      size_t      length = IIF( end, ( size_t ) ( end - config ), strlen( config ) );
+      const char *equals = memchr( config, '=', length );
+
+      if( !equals )
+      {
+         if( longestPrefix == 0 )
+         {
+            threads = atoi( config );
+         }
+      }
+      else
+      {
+         size_t prefixLength = equals - config;
+         /* the prefix must end at a path component, /mnt/nfs does not cover /mnt/nfs2 */
+         if( prefixLength > longestPrefix && strncmp( path, config, prefixLength ) == 0 &&
+             ( path[ prefixLength ] == PS[ 0 ] || path[ prefixLength ] == '\0' || config[ prefixLength - 1 ] == PS[ 0 ] ) )
+         {
+            longestPrefix = prefixLength;
+            threads = atoi( equals + 1 );
+         }
+      }
+
+      config = IIF( end, end + 1, NULL );
+   }
+
+   return NK_CLAMP( 1, threads, POOL_MAX_THREADS );
+}
+
+/* HC_STAT_BACKEND=uring selects the io_uring backend where it is compiled in */
+static int hc_statBackend( void )
+{
+   const char *backend = getenv( "HC_STAT_BACKEND" );
+
+#if defined( HC_HAVE_URING )
+   if( backend && strcmp( backend, "uring" ) == 0 )
+   {
+      return STAT_BACKEND_URING;
+   }
+#else
+   NK_UNUSED( backend );
+#endif
+
+   return STAT_BACKEND_SYNC;
+}
+
+static nk_bool hc_loadFonts( struct nk_context *ctx, const char *filePath, float height )
+{
+   if( !ctx || !filePath )
+      return F;
+
+   struct nk_font_atlas *atlas = NULL;
+   struct nk_font_config config = nk_font_config( 0 );
+   struct nk_font *font = NULL;
+
+   /* TODO */
+   static const nk_rune hc_ranges[] =
+   {
+      0x0020, 0x007F, /* ASCII */
+      0x0080, 0x00FF, /* Latin-1 Supplement */
+      0x0100, 0x017F, /* Latin-Extended-A */
+      0x0180, 0x024F, /* Latin-Extended-B */
+      0x2500, 0x257F, /* Box Drawing */
+      0x2580, 0x259F, /* Block Elements */
+      0
+   };
+
+   config.range = hc_ranges;
+
+   nk_sdl_font_stash_begin( &atlas );
+
+   font = nk_font_atlas_add_from_file( atlas, filePath, height, &config );
+
+   nk_sdl_font_stash_end();
+
+   if( font )
+   {
+      nk_style_set_font( ctx, &font->handle );
+      return T;
+   }
+   return F;
+}
+
+static void hc_resize( HC *selectedPanel, int col, int row, int maxCol, int maxRow )
+{
+   selectedPanel->col    = col;
+   selectedPanel->row    = row;
+   selectedPanel->maxCol = maxCol;
+   selectedPanel->maxRow = maxRow;
+}
+
+static void hc_drawPanel( struct nk_context *ctx, HC *selectedPanel )
+{
+   int row, i = 0;
+   int longestName = 4;
+   int longestSize = 0;
+   int longestAttr = 0;
+   struct nk_color bgColor;
+   struct nk_color textColor;
+
+   char title[ 64 ] = "";
+
+   if( selectedPanel->loading )
+   {
+      snprintf( title, sizeof( title ), " Loading... %d ", SDL_AtomicGet( &selectedPanel->fetchSlot->progress ) );
+   }
+
+   if( activePanel == selectedPanel )
+   {
+      hc_drawBox( ctx, &selectedPanel->box, selectedPanel->col, selectedPanel->row, selectedPanel->maxCol, selectedPanel->maxRow, BOX_DOUBLE, title, WHITE, BLACK );
+   }
+   else
+   {
+      hc_drawBox( ctx, &selectedPanel->box, selectedPanel->col, selectedPanel->row, selectedPanel->maxCol, selectedPanel->maxRow, BOX_SINGLE, title, WHITE, BLACK );
+   }
+
+   /* the placeholder of a loading panel has no directory to stat in */
+   if( !selectedPanel->loading )
+   {
+      hc_listingLoadInfo( selectedPanel->listing, selectedPanel->sortMode, selectedPanel->rowNo - INFO_PREFETCH, selectedPanel->rowNo + selectedPanel->maxRow + INFO_PREFETCH );
+   }
+
+   longestName = NK_MAX( longestName, hc_findLongestName( selectedPanel ) );
+   longestSize = hc_findLongestSize( selectedPanel );
+   longestAttr = hc_findLongestAttr( selectedPanel );
+   hc_rowLayout( selectedPanel, longestName, longestSize, longestAttr );
+
+   i += selectedPanel->rowNo;
+   for( row = selectedPanel->row + 1; row < selectedPanel->maxRow - 1; row++ )
+   {
+      if( i < selectedPanel->listing->count )
+      {
+         int entry = hc_listingEntry( selectedPanel->listing, selectedPanel->sortMode, i );
+         int flags = selectedPanel->listing->flags[ entry ];
+         int attrFlags = flags & DIRLIST_ATTR;
+         const char *paddedResult = hc_rowText( selectedPanel, i, entry );
+
+         if( activePanel == selectedPanel && i == selectedPanel->rowBar + selectedPanel->rowNo )
+         {
+            if( flags & DIRLIST_SELECTED )
+            {
+               bgColor   = BLACK;
+               textColor = RED;
+            }
+            else
+            {
+               bgColor   = BLACK;
+               textColor = LIGHT_GREEN;
+            }
+         }
+         else
+         {
+            if( flags & DIRLIST_SELECTED )
+            {
+               bgColor   = WHITE;
+               textColor = RED;
+            }
+            else if( attrFlags == ( DIRLIST_DIRECTORY | DIRLIST_HIDDEN ) || attrFlags == ( DIRLIST_ARCHIVE | DIRLIST_HIDDEN ) )
+            {
+               bgColor   = WHITE;
+               textColor = LIGHT_BLUE;
+            }
+            else
+            {
+               bgColor   = WHITE;
+               textColor = BLACK;
+            }
+         }
+
+         hc_drawText( ctx, selectedPanel->col + 1, row, paddedResult, bgColor, textColor );
+
+         ++i;
+      }
+      else
+      {
+         break;
+      }
+   }
+}
+
+static int hc_findLongestName( HC *selectedPanel )
+{
+   return hc_listingWidth( selectedPanel->listing, selectedPanel->listing->nameWidths, WIDTH_MAX );
+}
+
+static int hc_findLongestSize( HC *selectedPanel )
+{
+   return hc_listingWidth( selectedPanel->listing, selectedPanel->listing->sizeWidths, 20 );
+}
+
+static int hc_findLongestAttr( HC *selectedPanel )
+{
+   return hc_listingWidth( selectedPanel->listing, selectedPanel->listing->attrWidths, 4 );
+}
+
+/* Starts a new row version when anything the row texts depend on changed since the last frame */
+static void hc_rowLayout( HC *selectedPanel, int longestName, int longestSize, int longestAttr )
+{
+   RowLayout layout;
+
+   memset( &layout, 0, sizeof( RowLayout ) );
+   layout.listingSerial  = selectedPanel->listing->serial;
+   layout.listingVersion = selectedPanel->listing->version;
+   layout.maxCol         = selectedPanel->maxCol;
+   layout.longestName    = longestName;
+   layout.longestSize    = longestSize;
+   layout.longestAttr    = longestAttr;
+   layout.sizeVisible    = selectedPanel->sizeVisible;
+   layout.attrVisible    = selectedPanel->attrVisible;
+   layout.dateVisible    = selectedPanel->dateVisible;
+   layout.timeVisible    = selectedPanel->timeVisible;
+
+   if( selectedPanel->rowVersion == 0 || memcmp( &layout, &selectedPanel->rowLayout, sizeof( RowLayout ) ) != 0 )
+   {
+      selectedPanel->rowLayout = layout;
+      selectedPanel->rowVersion++;
+      hc_rowFormat( &selectedPanel->rowFormat, &layout );
+   }
+}
+
+/* Compiles the widths and visible columns of a layout once, rows are then emitted without
+   looking at the visibility flags again */
+static void hc_rowFormat( RowFormat *format, const RowLayout *layout )
+{
+   int space = 1;
+
+   memset( format, 0, sizeof( RowFormat ) );
+   format->width       = layout->maxCol - 2;
+   format->infoWidth   = format->width - layout->longestName;
+   format->nameWidth   = format->width - NK_MAX( format->infoWidth, 0 );
+   format->parentWidth = format->width - 4;
+
+   if( layout->sizeVisible )
+   {
+      format->column[ format->columns ]      = ROW_SIZE;
+      format->columnWidth[ format->columns++ ] = layout->longestSize;
+      format->infoLimit += layout->longestSize;
+   }
+   if( layout->attrVisible )
+   {
+      format->column[ format->columns ]      = ROW_ATTR;
+      format->columnWidth[ format->columns++ ] = layout->longestAttr;
+      format->infoLimit += layout->longestAttr;
+   }
+   if( layout->dateVisible )
+   {
+      format->column[ format->columns ]      = ROW_DATE;
+      format->columnWidth[ format->columns++ ] = - 1;
+   }
+   if( layout->timeVisible )
+   {
+      format->column[ format->columns ]      = ROW_TIME;
+      format->columnWidth[ format->columns++ ] = - 1;
+   }
+   format->infoLimit += IIF( layout->dateVisible, 11, space ) + IIF( layout->timeVisible, 10, space );
+}
+
+/* Text of the row at a listing position, formatted only when the entry there or the layout
+   changed since it was last drawn. Scrolling and moving the bar reuse the cached rows. */
+static const char *hc_rowText( HC *selectedPanel, int position, int entry )
+{
+   CachedRow *cached = &selectedPanel->rows[ position % ROW_CACHE ];
+   const char *name = hc_listingName( selectedPanel->listing, entry );
+   char size[ 20 ], date[ 11 ], time[ 9 ], attr[ 6 ];
+   size_t length;
+   char *line;
+
+   if( cached->text && cached->entry == entry && cached->version == selectedPanel->rowVersion )
+   {
+      return cached->text;
+   }
+
+   /* a name and its padding never take more than a byte per character beyond the name itself */
+   length = strlen( name ) + NK_MAX( selectedPanel->rowFormat.width, 0 ) + 5;
+   line = cached->text;
+   if( cached->capacity < length )
+   {
+      line = realloc( cached->text, length );
+      if( line )
+      {
+         cached->text     = line;
+         cached->capacity = length;
+      }
+      else
+      {
+         /* drawn from the frame arena this time, cached again once memory is back */
+         cached->version = 0;
+         line = hc_frameAlloc( length );
+         if( !line )
+         {
+            return "";
+         }
+      }
+   }
+
+   hc_listingFormat( selectedPanel->listing, entry, &selectedPanel->timeFormat, size, date, time, attr );
+   hc_rowEmit( &selectedPanel->rowFormat, line, name, size, date, time, attr );
+   if( line == cached->text )
+   {
+      cached->entry   = entry;
+      cached->version = selectedPanel->rowVersion;
+   }
+   return line;
+}
+
+/* Writes the text of a row into line and returns its length in bytes. Every part is copied
+   with memcpy at the widths compiled into the format. */
+static int hc_rowEmit( const RowFormat *format, char *line, const char *name, const char *size, const char *date, const char *time, const char *attr )
+{
+   const char *fields[ 4 ];   /* indexed by ROW_* */
+   char info[ 64 ];           /* size, attr, date and time with their separators */
+   int infoLength = 0;
+   int length = 0;
+   int i;
+
+   if( format->width <= 0 )
+   {
+      line[ 0 ] = '\0';
+      return 0;
+   }
+
+   fields[ ROW_SIZE ] = IIF( strchr( attr, 'D' ), "DIR", size );
+   fields[ ROW_ATTR ] = attr;
+   fields[ ROW_DATE ] = date;
+   fields[ ROW_TIME ] = time;
+
+   for( i = 0; i < format->columns; i++ )
+   {
+      const char *field = fields[ format->column[ i ] ];
+      int fieldLength = strlen( field );
+      int width = format->columnWidth[ i ];
+
+      if( i > 0 )
+      {
+         info[ infoLength++ ] = ' ';
+      }
+      if( width < 0 )
+      {
+         memcpy( info + infoLength, field, fieldLength );
+         infoLength += fieldLength;
+      }
+      else if( fieldLength >= width )
+      {
+         memcpy( info + infoLength, field, width );
+         infoLength += width;
+      }
+      else
+      {
+         memset( info + infoLength, ' ', width - fieldLength );
+         memcpy( info + infoLength + width - fieldLength, field, fieldLength );
+         infoLength += width;
+      }
+   }
+   if( format->columns == 0 )
+   {
+      info[ infoLength++ ] = ' ';
+   }
+   infoLength = NK_MIN( infoLength, format->infoLimit );
+
+   if( strcmp( name, ".." ) == 0 )
+   {
+      memcpy( line, "[..]", 4 );
+      length = 4 + hc_rowInfo( line + 4, info, infoLength, format->parentWidth );
+      length = NK_MIN( length, format->width );
+   }
+   else
+   {
+      int nameLength = hc_utf8Len( name );
+      const char *nameEnd = IIF( nameLength > format->nameWidth, hc_utf8CharPtrAt( name, format->nameWidth ), name + strlen( name ) );
+
+      length = nameEnd - name;
+      memcpy( line, name, length );
+      if( nameLength < format->nameWidth )
+      {
+         memset( line + length, ' ', format->nameWidth - nameLength );
+         length += format->nameWidth - nameLength;
+      }
+      length += hc_rowInfo( line + length, info, infoLength, format->infoWidth );
+   }
+
+   line[ length ] = '\0';
+   return length;
+}
+
+/* Right aligns the info columns in width characters, cutting them when they do not fit */
+static int hc_rowInfo( char *line, const char *info, int infoLength, int width )
+{
+   if( width <= 0 )
+   {
+      return 0;
+   }
+   if( infoLength >= width )
+   {
+      memcpy( line, info, width );
+   }
+   else
+   {
+      memset( line, ' ', width - infoLength );
+      memcpy( line + width - infoLength, info, infoLength );
+   }
+   return width;
+}
+
+static int hc_maxCol( struct nk_context *ctx )
+{
+   const struct nk_user_font *font = ctx->style.font;
+
+   if( font && font->width )
+   {
+      const char *sampleText = "W";
+      int sampleLength = 1;
+      float fontCellWidth = font->width( font->userdata, font->height, sampleText, sampleLength );
+
+      struct nk_rect bounds = nk_window_get_bounds( ctx );
+      return bounds.w / fontCellWidth;
+   }
+   else
+   {
+      return 0;
+   }
+}
+
+static int hc_maxRow( struct nk_context *ctx )
+{
+   const struct nk_user_font *font = ctx->style.font;
+
+   if( font && font->height > 0 )
+   {
+      float fontCellHeight = font->height;
+
+      struct nk_rect bounds = nk_window_get_bounds( ctx );
+      return bounds.h / fontCellHeight;
+   }
+   else
+   {
+      return 0;
+   }
+}
+
+/* Pixel rectangle of cols x rows character cells, the top left one at col, row */
+static struct nk_rect hc_cellRect( struct nk_context *ctx, int col, int row, int cols, int rows )
+{
+   const struct nk_user_font *font = ctx->style.font;
+   const char *sampleText = "W";
+   int sampleLength = 1;
+
+   float fontCellWidth = font->width( font->userdata, font->height, sampleText, sampleLength );
+   float fontCellHeight = font->height;
+
+   struct nk_rect windowBounds = nk_window_get_bounds( ctx );
+
+   float paddingX = ctx->style.window.padding.x + 2;
+
+   float x = windowBounds.x + paddingX + col * fontCellWidth;
+   /* TODO */
+   float y = windowBounds.y + ( row + 2 ) * fontCellHeight;
+
+   return nk_rect( x, y, cols * fontCellWidth, rows * fontCellHeight );
+}
+
+/* Writes text into the cells from col, row on, one cell per UTF-8 character */
+static void hc_drawText( struct nk_context *ctx, int col, int row, const char *text, struct nk_color bgColor, struct nk_color textColor )
+{
+   NK_UNUSED( ctx );
+
+   while( *text )
+   {
+      hc_gridPut( col++, row, hc_utf8Decode( &text ), bgColor, textColor );
+   }
+}
+
+static void hc_changeDir( HC *selectedPanel )
+{
+   int i = selectedPanel->rowBar + selectedPanel->rowNo;
+
+   if( strcmp( hc_listingNameAt( selectedPanel->listing, selectedPanel->sortMode, i ), ".." ) == 0 )
+   {
+      const char *tmpDir = hc_dirLastName( selectedPanel->currentDir );
+      const char *newDir;
+      newDir = hc_dirDeleteLastPath( selectedPanel->currentDir );
+
+      /* the bar returns to the directory we came from once the listing arrives */
+      hc_strncpy( selectedPanel->selectName, tmpDir );
+      selectedPanel->rowBar = 0;
+      selectedPanel->rowNo  = 0;
+
+      hc_updateFetchList( selectedPanel, newDir );
+   }
+   else
+   {
+      char *newDir = hc_addStr( selectedPanel->currentDir, hc_listingNameAt( selectedPanel->listing, selectedPanel->sortMode, i ), PS, NULL );
+      selectedPanel->rowBar = 0;
+      selectedPanel->rowNo  = 0;
+      selectedPanel->selectName[ 0 ] = '\0';
+
+      hc_updateFetchList( selectedPanel, newDir );
+      free( newDir );
+   }
+}
+
+static const char *hc_dirLastName( const char *path )
+{
+   static char result[ PATH_MAX ];
+   int pathLength;
+
+   if( path == NULL || ( pathLength = strlen( path ) ) == 0 )
+   {
+      result[ 0 ] = '\0';
+      return result;
+   }
+
+   char separator = PS[ 0 ];
+
+   if( path[ pathLength - 1 ] == separator )
+   {
+      pathLength--;
+   }
+
+   for( int i = pathLength - 1; i >= 0; i-- )
+   {
+      if( path[ i ] == separator )
+      {
+         int length = pathLength - i - 1;
+         strncpy( result, path + i + 1, length );
+         result[ length ] = '\0';
+         return result;
+      }
+   }
+
+   strncpy( result, path, pathLength );
+   result[ pathLength ] = '\0';
+
+   return result;
+}
+
+static const char *hc_dirDeleteLastPath( const char *path )
+{
+   static char result[ PATH_MAX ];
+   char *lastPath;
+
+   strncpy( result, path, sizeof( result ) - 1 );
+   result[ sizeof( result ) - 1 ] = '\0';
+
+   char separator = PS[ 0 ];
+
+   lastPath = strrchr( result, separator );
+   if( lastPath )
+   {
+      char *secondLastPath = NULL;
+      *lastPath = '\0';
+      secondLastPath = strrchr( result, separator );
+
+      if( secondLastPath )
+      {
+         *lastPath = separator;
+         *( secondLastPath + 1 ) = '\0';
+      }
+      else
       {
-         strcat( files[ count ].attr, "H" );
+         *lastPath = separator;
       }
+   }
+
+   return result;
+}
+
+static void hc_updateFetchList( HC *selectedPanel, const char *newDir )
+{
+   strncpy( selectedPanel->currentDir, newDir, sizeof( selectedPanel->currentDir ) - 1 );
+   selectedPanel->currentDir[ sizeof( selectedPanel->currentDir ) - 1 ] = '\0';
+   hc_fetchList( selectedPanel, newDir );
+}
 
-      count++;
+static int hc_dirIndexName( HC *selectedPanel, const char *tmpDir )
+{
+   for( int i = 0; i < selectedPanel->listing->count; i++ )
+   {
+      if( strcmp( hc_listingNameAt( selectedPanel->listing, selectedPanel->sortMode, i ), tmpDir ) == 0 )
+      {
+         return i;
+      }
    }
-   while( FindNextFile( hFind, &findFileData ) != 0 );
+   return - 1;
+}
 
-   FindClose( hFind );
+/* -------------------------------------------------------------------------
+Listing cache
+------------------------------------------------------------------------- */
+static void hc_cacheInit( void )
+{
+   memset( &listingCache, 0, sizeof( ListingCache ) );
 
-   /* Move the parent directory ("..") to the first position */
-   if( parentIndex > 0 )
+   listingCache.mutex  = SDL_CreateMutex();
+   listingCache.loaded = SDL_CreateCond();
+}
+
+/* Identifies the current state of a directory: device, inode and modification time */
+static nk_bool hc_cacheKey( const char *path, CacheEntry *key )
+{
+#if defined( _WIN32 ) || defined( _WIN64 )
+   NK_UNUSED( path );
+   NK_UNUSED( key );
+   return F;
+#else
+   struct stat dirInfo;
+
+   if( stat( path, &dirInfo ) == - 1 )
    {
-      DirList temp = files[ parentIndex ];
-      memmove( &files[ 1 ], &files[ 0 ], sizeof( DirList ) * parentIndex );
-      files[ 0 ] = temp;
+      return F;
    }
 
-   *size = count;
-   return files;
+   hc_strncpy( key->path, path );
+   key->dev      = dirInfo.st_dev;
+   key->ino      = dirInfo.st_ino;
+   key->mtimeSec = dirInfo.st_mtime;
+#if defined( __APPLE__ )
+   key->mtimeNsec = dirInfo.st_mtimespec.tv_nsec;
 #else
-   DirList *files = NULL;
-   int count = 0;
-   int parentIndex = - 1;
+   key->mtimeNsec = dirInfo.st_mtim.tv_nsec;
+#endif
 
-   DIR *pDir;
-   struct dirent *entry;
-   struct stat fileInfo;
+   return T;
+#endif
+}
 
-   pDir = opendir( currentDir );
-   if( pDir == NULL )
+/* Returns the cached listing of path with a new reference, waiting while another loader builds it.
+   On a miss it returns NULL and hands the caller a pending entry to pass to hc_cachePublish. */
+static Listing *hc_cacheAcquire( const char *path, int options, CacheEntry **pending )
+{
+   CacheEntry key;
+   CacheEntry *entry;
+
+   *pending = NULL;
+
+   if( !listingCache.mutex || !hc_cacheKey( path, &key ) )
    {
-      fprintf( stderr, "Directory cannot be opened: %s\n", currentDir );
       return NULL;
    }
 
-   while( ( entry = readdir( pDir ) ) != NULL )
+   SDL_LockMutex( listingCache.mutex );
+   for( ;; )
    {
-      if( strcmp( entry->d_name, "." ) == 0 )
-      {
-         continue;
-      }
-
-      if( strcmp( entry->d_name, ".." ) == 0 )
+      for( entry = listingCache.entries; entry; entry = entry->next )
       {
-         parentIndex = count;
-      }
-
-      {
-         char fullPath[ PATH_MAX ];
-         snprintf( fullPath, sizeof( fullPath ), "%s/%s", currentDir, entry->d_name );
-
-         if( stat( fullPath, &fileInfo ) == - 1 )
+         if( entry->dev == key.dev && entry->ino == key.ino && entry->mtimeSec == key.mtimeSec &&
+             entry->mtimeNsec == key.mtimeNsec && entry->options == options && strcmp( entry->path, key.path ) == 0 )
          {
-            perror( "Error getting file info" );
-            continue;
+            break;
          }
       }
 
+      if( !entry )
       {
-         DirList *temp = realloc( files, ( count + 1 ) * sizeof( DirList ) );
-         if( !temp )
+         entry = malloc( sizeof( CacheEntry ) );
+         if( entry )
          {
-            closedir( pDir );
-            free( files );
-            return NULL;
+            *entry = key;
+            entry->options = options;
+            entry->listing = NULL;
+            entry->removed = F;
+            entry->waiters = 0;
+            entry->next    = listingCache.entries;
+            listingCache.entries = entry;
          }
-         files = temp;
+         *pending = entry;
+         SDL_UnlockMutex( listingCache.mutex );
+         return NULL;
       }
 
-      files[ count ].state = F;
-      strncpy( files[ count ].name, entry->d_name, sizeof( files[ count ].name ) - 1 );
-      files[ count ].name[ sizeof( files[ count ].name ) - 1 ] = '\0';
-
-      snprintf( files[ count ].size, sizeof( files[ count ].size ), "%ld", fileInfo.st_size );
-
+      ++entry->waiters;
+      while( !entry->listing && !entry->removed )
       {
-         struct tm *tm = localtime( &fileInfo.st_mtime );
-         strftime( files[ count ].date, sizeof( files[ count ].date ), "%d-%m-%Y", tm );
-         strftime( files[ count ].time, sizeof( files[ count ].time ), "%H:%M:%S", tm );
+         SDL_CondWait( listingCache.loaded, listingCache.mutex );
       }
+      --entry->waiters;
 
-      strcpy( files[ count ].attr, "" );
-      if( S_ISREG( fileInfo.st_mode ) )
-      {
-         strcat( files[ count ].attr, "A" );
-         if( fileInfo.st_mode & S_IXUSR )
-         {
-            strcat( files[ count ].attr, "E" );
-         }
-      }
-      if( S_ISDIR( fileInfo.st_mode ) )
+      if( entry->listing )
       {
-         strcat( files[ count ].attr, "D" );
+         Listing *listing = entry->listing;
+         ++listing->refCount;
+         SDL_UnlockMutex( listingCache.mutex );
+         return listing;
       }
-      if( entry->d_name[ 0 ] == '.' )
+
+      /* the loader gave up on it; look again and possibly build it ourselves */
+      if( entry->waiters == 0 )
       {
-         strcat( files[ count ].attr, "H" );
+         free( entry );
       }
+   }
+}
 
-      count++;
+/* Completes a pending entry with the listing its loader built, or withdraws it when listing is NULL */
+static void hc_cachePublish( CacheEntry *entry, Listing *listing )
+{
+   SDL_LockMutex( listingCache.mutex );
+   if( listing )
+   {
+      entry->listing = listing;
+      listing->cacheEntry = entry;
+   }
+   else
+   {
+      hc_cacheRemove( entry );
    }
+   SDL_CondBroadcast( listingCache.loaded );
+   SDL_UnlockMutex( listingCache.mutex );
+}
 
-   closedir( pDir );
+/* Unlinks an entry; called with the cache mutex held */
+static void hc_cacheRemove( CacheEntry *entry )
+{
+   CacheEntry **link = &listingCache.entries;
 
-   /* Move the parent directory ("..") to the first position if found */
-   if( parentIndex > 0 )
+   while( *link && *link != entry )
+   {
+      link = &( *link )->next;
+   }
+   if( *link )
    {
-      DirList temp = files[ parentIndex ];
-      memmove( &files[ 1 ], &files[ 0 ], sizeof( DirList ) * parentIndex );
-      files[ 0 ] = temp;
+      *link = entry->next;
    }
 
-   *size = count;
-   return files;
-#endif
+   if( entry->listing )
+   {
+      entry->listing->cacheEntry = NULL;
+   }
+   entry->listing = NULL;
+   entry->removed = T;
+
+   if( entry->waiters == 0 )
+   {
+      free( entry );
+   }
+   else
+   {
+      SDL_CondBroadcast( listingCache.loaded );
+   }
 }
 
-static nk_bool hc_loadFonts( struct nk_context *ctx, const char *filePath, float height )
+#if defined( __linux__ )
+/* Moves the key of a cached listing to the current state of its directory, after the listing
+   was brought up to date in place */
+static void hc_cacheTouch( Listing *listing )
 {
-   if( !ctx || !filePath )
-      return F;
+   struct stat dirInfo;
+   CacheEntry *entry;
 
-   struct nk_font_atlas *atlas = NULL;
-   struct nk_font_config config = nk_font_config( 0 );
-   struct nk_font *font = NULL;
+   if( !listingCache.mutex || stat( listing->path, &dirInfo ) == - 1 )
+   {
+      return;
+   }
 
-   /* TODO */
-   static const nk_rune hc_ranges[] =
+   SDL_LockMutex( listingCache.mutex );
+   for( entry = listingCache.entries; entry; entry = entry->next )
    {
-      0x0020, 0x007F, /* ASCII */
-      0x0080, 0x00FF, /* Latin-1 Supplement */
-      0x0100, 0x017F, /* Latin-Extended-A */
-      0x0180, 0x024F, /* Latin-Extended-B */
-      0x2500, 0x257F, /* Box Drawing */
-      0x2580, 0x259F, /* Block Elements */
-      0
-   };
+      if( entry->listing == listing && entry->dev == ( uint64_t ) dirInfo.st_dev && entry->ino == ( uint64_t ) dirInfo.st_ino )
+      {
+         entry->mtimeSec  = dirInfo.st_mtime;
+         entry->mtimeNsec = dirInfo.st_mtim.tv_nsec;
+      }
+   }
+   SDL_UnlockMutex( listingCache.mutex );
+}
 
-   config.range = hc_ranges;
+/* Tells whether the directory of a cached listing changed since the listing was keyed,
+   e.g. while it was enumerated and nothing watched it yet */
+static nk_bool hc_cacheStale( Listing *listing )
+{
+   struct stat dirInfo;
+   nk_bool stale = F;
 
-   nk_sdl_font_stash_begin( &atlas );
+   if( !listingCache.mutex || stat( listing->path, &dirInfo ) == - 1 )
+   {
+      return F;
+   }
 
-   font = nk_font_atlas_add_from_file( atlas, filePath, height, &config );
+   SDL_LockMutex( listingCache.mutex );
+   if( listing->cacheEntry )
+   {
+      stale = listing->cacheEntry->mtimeSec != dirInfo.st_mtime || listing->cacheEntry->mtimeNsec != dirInfo.st_mtim.tv_nsec;
+   }
+   SDL_UnlockMutex( listingCache.mutex );
 
-   nk_sdl_font_stash_end();
+   return stale;
+}
 
-   if( font )
+/* Takes a listing out of the cache, so the next load of its directory reads it again */
+static void hc_cacheForget( Listing *listing )
+{
+   if( !listingCache.mutex )
    {
-      nk_style_set_font( ctx, &font->handle );
-      return T;
+      return;
    }
-   return F;
+
+   SDL_LockMutex( listingCache.mutex );
+   if( listing->cacheEntry )
+   {
+      hc_cacheRemove( listing->cacheEntry );
+   }
+   SDL_UnlockMutex( listingCache.mutex );
 }
+#endif
 
-static void hc_resize( HC *selectedPanel, int col, int row, int maxCol, int maxRow )
+/* -------------------------------------------------------------------------
+File watch
+------------------------------------------------------------------------- */
+static void hc_watchInit( void )
 {
-   selectedPanel->col    = col;
-   selectedPanel->row    = row;
-   selectedPanel->maxCol = maxCol;
-   selectedPanel->maxRow = maxRow;
+#if defined( __linux__ )
+   SDL_Thread *thread;
+
+   fileWatch.fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+   if( fileWatch.fd == - 1 )
+   {
+      fprintf( stderr, "inotify_init1 failed, panels will not refresh by themselves. \n" );
+      return;
+   }
+
+   fileWatch.mutex = SDL_CreateMutex();
+   SDL_AtomicSet( &fileWatch.pending, 0 );
+
+   /* exits with the process, like loaders still walking a slow directory */
+   thread = SDL_CreateThread( hc_watchThread, "hc_watch", NULL );
+   if( thread )
+   {
+      SDL_DetachThread( thread );
+   }
+#endif
 }
 
-static void hc_drawPanel( struct nk_context *ctx, HC *selectedPanel )
+/* Starts watching the directory of a listing that was just put in a panel */
+static void hc_watchListing( Listing *listing )
 {
-   int row, i = 0;
-   int longestName = 4;
-   int longestSize = 0;
-   int longestAttr = 0;
-   struct nk_color bgColor;
-   struct nk_color textColor;
+#if defined( __linux__ )
+   int wd;
+   int i;
+   int slot = - 1;
 
-   if( activePanel == selectedPanel )
+   if( !listing || listing->watch != - 1 || fileWatch.fd == - 1 )
    {
-      hc_drawBox( ctx, selectedPanel->col, selectedPanel->row, selectedPanel->maxCol, selectedPanel->maxRow, BOX_DOUBLE, WHITE, BLACK );
+      return;
    }
-   else
+
+   wd = inotify_add_watch( fileWatch.fd, listing->path, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                           IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_ONLYDIR );
+   if( wd == - 1 )
    {
-      hc_drawBox( ctx, selectedPanel->col, selectedPanel->row, selectedPanel->maxCol, selectedPanel->maxRow, BOX_SINGLE, WHITE, BLACK );
+      return;
    }
 
-   longestName = NK_MAX( longestName, hc_findLongestName( selectedPanel ) );
-   longestSize = hc_findLongestSize( selectedPanel );
-   longestAttr = hc_findLongestAttr( selectedPanel );
+   SDL_LockMutex( fileWatch.mutex );
+   for( i = 0; i < WATCH_MAX; i++ )
+   {
+      if( fileWatch.users[ i ] > 0 && fileWatch.wds[ i ] == wd )
+      {
+         slot = i;
+         break;
+      }
+      if( slot == - 1 && fileWatch.users[ i ] == 0 )
+      {
+         slot = i;
+      }
+   }
+   if( slot != - 1 )
+   {
+      fileWatch.wds[ slot ] = wd;
+      ++fileWatch.users[ slot ];
+      listing->watch = wd;
+   }
+   SDL_UnlockMutex( fileWatch.mutex );
 
-   i += selectedPanel->rowNo;
-   for( row = selectedPanel->row + 1; row < selectedPanel->maxRow - 1; row++ )
+   if( slot == - 1 )
+   {
+      /* table full; a watch nobody else uses must not stay behind */
+      inotify_rm_watch( fileWatch.fd, wd );
+   }
+#else
+   NK_UNUSED( listing );
+#endif
+}
+
+/* Drops one listing from a watch descriptor; the last one removes the watch */
+static void hc_watchRelease( int wd )
+{
+#if defined( __linux__ )
+   nk_bool inUse = T;
+   int i;
+
+   SDL_LockMutex( fileWatch.mutex );
+   for( i = 0; i < WATCH_MAX; i++ )
    {
-      if( i < selectedPanel->itemCount )
+      if( fileWatch.users[ i ] > 0 && fileWatch.wds[ i ] == wd )
       {
-         const char *paddedString = hc_paddedString( selectedPanel, longestName, longestSize, longestAttr,
-                                                     selectedPanel->dirList[ i ].name,
-                                                     selectedPanel->dirList[ i ].size,
-                                                     selectedPanel->dirList[ i ].date,
-                                                     selectedPanel->dirList[ i ].time,
-                                                     selectedPanel->dirList[ i ].attr );
+         inUse = --fileWatch.users[ i ] > 0;
+         break;
+      }
+   }
+   SDL_UnlockMutex( fileWatch.mutex );
+
+   /* a watch missing from the table was dropped by the kernel already */
+   if( !inUse )
+   {
+      inotify_rm_watch( fileWatch.fd, wd );
+   }
+#else
+   NK_UNUSED( wd );
+#endif
+}
 
-         char *paddedResult = hc_padR( paddedString, selectedPanel->maxCol - 2 );
+/* Applies everything the watched directories reported since the last frame. Events are
+   coalesced per entry, so a file written a thousand times costs one stat. */
+static void hc_watchPoll( HC *leftPanel, HC *rightPanel )
+{
+#if defined( __linux__ )
+   static char buffer[ WATCH_BUFFER ] __attribute__( ( aligned( __alignof__( struct inotify_event ) ) ) );
+   WatchChange *changes = NULL;
+   int changeCount = 0;
+   int changeCapacity = 0;
+   nk_bool overflow = F;
+   ssize_t length;
+   int i;
 
-         if( activePanel == selectedPanel && i == selectedPanel->rowBar + selectedPanel->rowNo )
+   if( fileWatch.fd == - 1 || !SDL_AtomicGet( &fileWatch.pending ) )
+   {
+      return;
+   }
+
+   while( ( length = read( fileWatch.fd, buffer, sizeof( buffer ) ) ) > 0 )
+   {
+      ssize_t offset = 0;
+
+      while( offset < length )
+      {
+         const struct inotify_event *event = ( const struct inotify_event * ) ( buffer + offset );
+         offset += sizeof( struct inotify_event ) + event->len;
+
+         if( event->mask & IN_Q_OVERFLOW )
          {
-            if( selectedPanel->dirList[ i ].state == T )
-            {
-               bgColor   = BLACK;
-               textColor = RED;
-            }
-            else
-            {
-               bgColor   = BLACK;
-               textColor = LIGHT_GREEN;
-            }
+            overflow = T;
          }
-         else
+         else if( event->mask & IN_IGNORED )
          {
-            if( selectedPanel->dirList[ i ].state == T )
+            /* the directory is gone; its listings keep what they have and the kernel already dropped the watch,
+               so they must not remove it again once its descriptor may name another directory */
+            SDL_LockMutex( fileWatch.mutex );
+            for( i = 0; i < WATCH_MAX; i++ )
             {
-               bgColor   = WHITE;
-               textColor = RED;
+               if( fileWatch.users[ i ] > 0 && fileWatch.wds[ i ] == event->wd )
+               {
+                  fileWatch.users[ i ] = 0;
+               }
             }
-            else if( strcmp( selectedPanel->dirList[ i ].attr, "DH" ) == 0 || strcmp( selectedPanel->dirList[ i ].attr, "AH" ) == 0 )
+            SDL_UnlockMutex( fileWatch.mutex );
+
+            if( leftPanel->listing->watch == event->wd )
             {
-               bgColor   = WHITE;
-               textColor = LIGHT_BLUE;
+               leftPanel->listing->watch = - 1;
             }
-            else
+            if( rightPanel->listing->watch == event->wd )
+            {
+               rightPanel->listing->watch = - 1;
+            }
+         }
+         else if( event->len > 0 && !overflow )
+         {
+            if( changeCount >= changeCapacity )
             {
-               bgColor   = WHITE;
-               textColor = BLACK;
+               int newCapacity = IIF( changeCapacity > 0, changeCapacity * 2, 64 );
+               WatchChange *temp = realloc( changes, sizeof( WatchChange ) * newCapacity );
+               if( !temp )
+               {
+                  overflow = T;
+                  continue;
+               }
+               changes = temp;
+               changeCapacity = newCapacity;
             }
+            changes[ changeCount ].wd = event->wd;
+            strncpy( changes[ changeCount ].name, event->name, sizeof( changes[ changeCount ].name ) - 1 );
+            changes[ changeCount ].name[ sizeof( changes[ changeCount ].name ) - 1 ] = '\0';
+            ++changeCount;
          }
+      }
+   }
 
-         hc_drawText( ctx, selectedPanel->col + 1, row, paddedResult, bgColor, textColor );
-
-         free( paddedResult );
+   /* events arriving from now on wake the loop again */
+   SDL_AtomicSet( &fileWatch.pending, 0 );
 
-         ++i;
+   if( overflow )
+   {
+      /* a listing both panels shared is still held by the right one after the left reloads,
+         the second load then finds the first one's in the cache */
+      hc_watchReload( leftPanel );
+      hc_watchReload( rightPanel );
+   }
+   else if( changeCount > 0 )
+   {
+      char leftName[ PATH_MAX ] = "";
+      char rightName[ PATH_MAX ] = "";
+      int leftIndex  = leftPanel->rowBar + leftPanel->rowNo;
+      int rightIndex = rightPanel->rowBar + rightPanel->rowNo;
+      Listing *leftListing  = leftPanel->listing;
+      Listing *rightListing = rightPanel->listing;
+
+      if( leftIndex < leftListing->count )
+      {
+         hc_strncpy( leftName, hc_listingNameAt( leftListing, leftPanel->sortMode, leftIndex ) );
       }
-      else
+      if( rightIndex < rightListing->count )
       {
-         break;
+         hc_strncpy( rightName, hc_listingNameAt( rightListing, rightPanel->sortMode, rightIndex ) );
       }
-   }
-}
 
-static int hc_findLongestName( HC *selectedPanel )
-{
-   int longestName = 0;
-   int i;
+      qsort( changes, changeCount, sizeof( WatchChange ), hc_watchChangeCompare );
+      for( i = 0; i < changeCount; i++ )
+      {
+         if( i == 0 || hc_watchChangeCompare( &changes[ i - 1 ], &changes[ i ] ) != 0 )
+         {
+            hc_watchApply( leftPanel, rightPanel, changes[ i ].wd, changes[ i ].name );
+         }
+      }
 
-   for( i = 0; i < selectedPanel->itemCount; i++ )
-   {
-      int currentNameLength = hc_utf8Len( selectedPanel->dirList[ i ].name );
-      if( currentNameLength > longestName )
+      hc_keepSelection( leftPanel, leftName, leftIndex );
+      hc_keepSelection( rightPanel, rightName, rightIndex );
+
+      hc_cacheTouch( leftListing );
+      if( rightListing != leftListing )
       {
-         longestName = currentNameLength;
+         hc_cacheTouch( rightListing );
       }
    }
-   return longestName;
+
+   free( changes );
+#else
+   NK_UNUSED( leftPanel );
+   NK_UNUSED( rightPanel );
+#endif
 }
 
-static int hc_findLongestSize( HC *selectedPanel )
+#if defined( __linux__ )
+/* Waits for inotify events and wakes the event loop, then sleeps until hc_watchPoll drained them */
+static int hc_watchThread( void *data )
 {
-   int longestSize = 0;
-   int i;
+   struct pollfd pollFd;
+
+   NK_UNUSED( data );
+
+   pollFd.fd     = fileWatch.fd;
+   pollFd.events = POLLIN;
 
-   for( i = 0; i < selectedPanel->itemCount; i++ )
+   for( ;; )
    {
-      int currentSizeLength = strlen( selectedPanel->dirList[ i ].size );
-      if( currentSizeLength > longestSize )
+      if( poll( &pollFd, 1, - 1 ) == - 1 )
       {
-         longestSize = currentSizeLength;
+         if( errno == EINTR )
+         {
+            continue;
+         }
+         break;
       }
-   }
-   return longestSize;
-}
 
-static int hc_findLongestAttr( HC *selectedPanel )
-{
-   int longestAttr = 0;
-   int i;
+      SDL_AtomicSet( &fileWatch.pending, 1 );
+      hc_wakeEventLoop();
 
-   for( i = 0; i < selectedPanel->itemCount; i++ )
-   {
-      int currentAttrLength = strlen( selectedPanel->dirList[ i ].attr );
-      if( currentAttrLength > longestAttr )
+      while( SDL_AtomicGet( &fileWatch.pending ) )
       {
-         longestAttr = currentAttrLength;
+         SDL_Delay( WATCH_INTERVAL );
       }
    }
-   return longestAttr;
+
+   return 0;
 }
 
-static const char *hc_paddedString( HC *selectedPanel, int longestName, int longestSize, int longestAttr, const char *name, const char *size, const char *date, const char *time, const char *attr )
+static int hc_watchChangeCompare( const void *A, const void *B )
 {
-   int lengthName = longestName;
-   int lengthSize;
-   int lengthAttr;
-   int lengthDate;
-   int lengthTime;
-   int parentDir = 4;
-   int space     = 1;
-   int border    = 2;
-   int nullTerminator = 1;
-
-   static char formattedLine[ PATH_MAX ];
+   const WatchChange *changeA = A;
+   const WatchChange *changeB = B;
 
-   if( strchr( attr, 'D' ) )
+   if( changeA->wd != changeB->wd )
    {
-      size = "DIR";
+      return IIF( changeA->wd < changeB->wd, - 1, 1 );
    }
+   return strcmp( changeA->name, changeB->name );
+}
 
-   IIF( selectedPanel->sizeVisible, lengthSize = longestSize, lengthSize = 0 );
-   IIF( selectedPanel->attrVisible, lengthAttr = longestAttr, lengthAttr = 0 );
-   IIF( selectedPanel->dateVisible, lengthDate = 11, lengthDate = space );
-   IIF( selectedPanel->timeVisible, lengthTime = 10, lengthTime = space );
-
-   char *padLAttr = hc_padL( attr, lengthAttr );
-   char *padLSize = hc_padL( size, lengthSize );
-
-   char sizeAttrDateTime[ lengthSize + lengthAttr + lengthDate + lengthTime + nullTerminator ];
-
-   if( selectedPanel->sizeVisible && selectedPanel->attrVisible && selectedPanel->dateVisible && selectedPanel->timeVisible )
-   {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s %s %s %s", padLSize, padLAttr, date, time );
-   }
-   else if( selectedPanel->sizeVisible && selectedPanel->attrVisible && selectedPanel->dateVisible )
-   {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s %s %s", padLSize, padLAttr, date );
-   }
-   else if( selectedPanel->sizeVisible && selectedPanel->attrVisible && selectedPanel->timeVisible )
-   {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s %s %s", padLSize, padLAttr, time );
-   }
-   else if( selectedPanel->sizeVisible && selectedPanel->attrVisible )
-   {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s %s", padLSize, padLAttr );
-   }
-   else if( selectedPanel->sizeVisible && selectedPanel->dateVisible && selectedPanel->timeVisible)
-   {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s %s %s", padLSize, date, time );
-   }
-   else if( selectedPanel->sizeVisible && selectedPanel->dateVisible )
-   {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s %s", padLSize, date );
-   }
-   else if( selectedPanel->sizeVisible && selectedPanel->timeVisible )
-   {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s %s", padLSize, time );
-   }
-   else if ( selectedPanel->sizeVisible)
-   {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s", padLSize );
-   }
-   else if( selectedPanel->attrVisible && selectedPanel->dateVisible && selectedPanel->timeVisible )
-   {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s %s %s", padLAttr, date, time );
-   }
-   else if( selectedPanel->attrVisible && selectedPanel->dateVisible )
+/* Refreshes one entry in every finished listing watched through wd; a listing shared by both panels only once */
+static void hc_watchApply( HC *leftPanel, HC *rightPanel, int wd, const char *name )
+{
+   if( !leftPanel->loading && leftPanel->listing->watch == wd )
    {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s %s", padLAttr, date );
+      hc_listingRefreshEntry( leftPanel->listing, name );
    }
-   else if( selectedPanel->attrVisible && selectedPanel->timeVisible )
+   if( !rightPanel->loading && rightPanel->listing->watch == wd && rightPanel->listing != leftPanel->listing )
    {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s %s", padLAttr, time );
+      hc_listingRefreshEntry( rightPanel->listing, name );
    }
-   else if( selectedPanel->attrVisible )
+}
+
+/* Events were lost; reads the directory of a panel again, keeping the bar on its entry */
+static void hc_watchReload( HC *selectedPanel )
+{
+   int index = selectedPanel->rowBar + selectedPanel->rowNo;
+
+   if( selectedPanel->loading || selectedPanel->listing->watch == - 1 )
    {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s", padLAttr );
+      return;
    }
-   else if( selectedPanel->dateVisible && selectedPanel->timeVisible )
+
+   if( index > 0 && index < selectedPanel->listing->count )
    {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s %s", date, time );
+      hc_strncpy( selectedPanel->selectName, hc_listingNameAt( selectedPanel->listing, selectedPanel->sortMode, index ) );
    }
-   else if( selectedPanel->dateVisible )
+
+   hc_cacheForget( selectedPanel->listing );
+   hc_fetchList( selectedPanel, selectedPanel->currentDir );
+}
+
+/* Keeps the bar on the entry called name, scrolling only when it left the visible rows, and
+   then keeping the bar at its height. When the entry is gone, the bar stays where it was. */
+static void hc_keepSelection( HC *selectedPanel, const char *name, int index )
+{
+   int position = - 1;
+   int entry;
+
+   if( selectedPanel->loading )
    {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s", date );
+      return;
    }
-   else if( selectedPanel->timeVisible )
+
+   if( name[ 0 ] && ( entry = hc_listingFind( selectedPanel->listing, name ) ) >= 0 )
    {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), "%s", time );
+      position = hc_listingPosition( selectedPanel->listing, selectedPanel->sortMode, entry );
    }
-   else
+   if( position < 0 )
    {
-      snprintf( sizeAttrDateTime, sizeof( sizeAttrDateTime ), " " );
+      position = NK_MIN( index, selectedPanel->listing->count - 1 );
    }
+   position = NK_MAX( position, 0 );
 
-   if( strcmp( name, ".." ) == 0 )
+   if( position < selectedPanel->rowNo || position - selectedPanel->rowNo > selectedPanel->maxRow - 3 )
    {
-      const char *lBracket = "[";
-      const char *rBracket = "]";
+      selectedPanel->rowNo = NK_MAX( position - selectedPanel->rowBar, 0 );
+   }
+   selectedPanel->rowBar = position - selectedPanel->rowNo;
+}
 
-      char *padLSizeAttrDateTime = hc_padL( sizeAttrDateTime, selectedPanel->maxCol - border - parentDir );
+/* First position of the name order whose entry does not sort before the entry called name with flags */
+static int hc_listingLowerBound( const Listing *listing, const char *name, int flags )
+{
+   const uint32_t *order = listing->orders[ SORT_NAME ];
+   int low = 0;
+   int high = listing->count;
 
-      size_t max_len = sizeof( formattedLine ) - strlen( lBracket ) - strlen( name ) - strlen( rBracket ) - 1;
-      if( strlen( padLSizeAttrDateTime ) > max_len )
+   while( low < high )
+   {
+      int middle = low + ( high - low ) / 2;
+      int entry = order[ middle ];
+      if( hc_compareEntries( hc_listingName( listing, entry ), listing->flags[ entry ], name, flags ) < 0 )
       {
-         padLSizeAttrDateTime[ max_len ] = '\0';
+         low = middle + 1;
+      }
+      else
+      {
+         high = middle;
       }
-      snprintf( formattedLine, sizeof( formattedLine ), "%s%s%s%s", lBracket, name, rBracket, padLSizeAttrDateTime );
-
-      free( padLSizeAttrDateTime );
    }
-   else
-   {
-      char *padLSizeAttrDateTime = hc_padL( sizeAttrDateTime, selectedPanel->maxCol - border - lengthName );
 
-      int availableWidthForName = selectedPanel->maxCol - border - strlen( padLSizeAttrDateTime );
+   return low;
+}
 
-      char *cutName = hc_left( name, availableWidthForName );
+/* Moves one entry of a sorted permutation to where it sorts now */
+static void hc_listingPlace( Listing *listing, int mode, int entry )
+{
+   uint32_t *order = listing->orders[ mode ];
+   int last = listing->count - 1;
+   int position = hc_listingPosition( listing, mode, entry );
+   SortKey key;
+   int low = 0;
+   int high = last;
 
-      char *padRName = hc_padR( cutName, availableWidthForName );
+   hc_listingMove( order, position, last );
 
-      snprintf( formattedLine, sizeof( formattedLine ), "%s%s", padRName, padLSizeAttrDateTime );
+   hc_sortKeyMake( listing, mode, entry, &key );
+   while( low < high )
+   {
+      int middle = low + ( high - low ) / 2;
+      SortKey other;
 
-      free( cutName );
-      free( padRName );
-      free( padLSizeAttrDateTime );
+      hc_sortKeyMake( listing, mode, order[ middle ], &other );
+      if( hc_sortKeyCompare( listing, mode, &other, &key ) < 0 )
+      {
+         low = middle + 1;
+      }
+      else
+      {
+         high = middle;
+      }
    }
 
-   free( padLAttr );
-   free( padLSize );
-
-   return formattedLine;
+   hc_listingMove( order, last, low );
 }
 
-static int hc_maxCol( struct nk_context *ctx )
+/* Entry called name, - 1 when missing. A sorted name order is searched for it both as a
+   directory and as a file, since the sort order depends on that. */
+static int hc_listingFind( const Listing *listing, const char *name )
 {
-   const struct nk_user_font *font = ctx->style.font;
+   int i;
 
-   if( font && font->width )
+   if( listing->orders[ SORT_NAME ] && strcmp( name, ".." ) != 0 )
    {
-      const char *sampleText = "W";
-      int sampleLength = 1;
-      float fontCellWidth = font->width( font->userdata, font->height, sampleText, sampleLength );
+      int pass;
 
-      struct nk_rect bounds = nk_window_get_bounds( ctx );
-      return bounds.w / fontCellWidth;
+      for( pass = 0; pass < 2; pass++ )
+      {
+         i = hc_listingLowerBound( listing, name, hc_nameFlags( name, pass == 0 ) );
+         if( i < listing->count && strcmp( hc_listingName( listing, listing->orders[ SORT_NAME ][ i ] ), name ) == 0 )
+         {
+            return listing->orders[ SORT_NAME ][ i ];
+         }
+      }
+      return - 1;
    }
-   else
+
+   for( i = 0; i < listing->count; i++ )
    {
-      return 0;
+      if( strcmp( hc_listingName( listing, i ), name ) == 0 )
+      {
+         return i;
+      }
    }
+   return - 1;
 }
 
-static int hc_maxRow( struct nk_context *ctx )
+/* Brings one entry of a listing up to date with the directory: updates it in place, inserts it
+   at its sorted position or removes it. Returns T when the listing changed. */
+static nk_bool hc_listingRefreshEntry( Listing *listing, const char *name )
 {
-   const struct nk_user_font *font = ctx->style.font;
+   struct stat fileInfo;
+   int sortMode;
+   int entry;
+   int result;
 
-   if( font && font->height > 0 )
+   if( strcmp( name, "." ) == 0 || strcmp( name, ".." ) == 0 )
    {
-      float fontCellHeight = font->height;
-
-      struct nk_rect bounds = nk_window_get_bounds( ctx );
-      return bounds.h / fontCellHeight;
+      return F;
    }
-   else
+
+   if( listing->dirFd != - 1 )
    {
-      return 0;
+      result = fstatat( listing->dirFd, name, &fileInfo, 0 );
    }
-}
-
-static void hc_drawText( struct nk_context *ctx, int col, int row, const char *text, struct nk_color bgColor, struct nk_color textColor )
-{
-   const struct nk_user_font *font = ctx->style.font;
-   const char *sampleText = "W";
-   int sampleLength = 1;
-
-   if( !font )
+   else
    {
-      printf( "Error: No font set in context.\n" );
-      return;
+      char fullPath[ PATH_MAX ];
+      if( snprintf( fullPath, sizeof( fullPath ), "%s/%s", listing->path, name ) >= ( int ) sizeof( fullPath ) )
+      {
+         result = - 1;
+      }
+      else
+      {
+         result = stat( fullPath, &fileInfo );
+      }
    }
 
-   float fontCellWidth = font->width( font->userdata, font->height, sampleText, sampleLength );
-   float fontCellHeight = font->height;
-
-   struct nk_rect windowBounds = nk_window_get_bounds( ctx );
-
-   float paddingX = ctx->style.window.padding.x + 2;
-
-   float x = windowBounds.x + paddingX + col * fontCellWidth;
-   /* TODO */
-   float y = windowBounds.y + ( row + 2 ) * fontCellHeight;
+   entry = hc_listingFind( listing, name );
 
-   struct nk_command_buffer *canvas = nk_window_get_canvas( ctx );
-   if( !canvas )
+   if( result == - 1 )
    {
-      printf( "Error: No canvas available.\n" );
-      return;
+      if( entry < 0 )
+      {
+         return F;
+      }
+      hc_listingRemove( listing, entry );
+      return T;
    }
 
-   struct nk_rect textBackground = nk_rect( x, y, strlen( text ) * fontCellWidth, fontCellHeight );
-   nk_fill_rect( canvas, textBackground, 0.0f, bgColor );
-
-   struct nk_rect textRect = textBackground;
-   textRect.y -= 1;
-
-   nk_draw_text( canvas, textRect, text, strlen( text ), font, bgColor, textColor );
-}
-
-static void hc_changeDir( HC *selectedPanel )
-{
-   int i = selectedPanel->rowBar + selectedPanel->rowNo;
-
-   if( strcmp( selectedPanel->dirList[ i ].name, ".." ) == 0 )
+   if( entry < 0 )
    {
-      const char *tmpDir = hc_dirLastName( selectedPanel->currentDir );
-      const char *newDir;
-      newDir = hc_dirDeleteLastPath( selectedPanel->currentDir );
-
-      hc_updateFetchList( selectedPanel, newDir );
-
-      int lastPosition = NK_MAX( hc_dirIndexName( selectedPanel, tmpDir ), 1 ) ;
-      if( lastPosition > activePanel->maxRow -3 )
+      entry = hc_listingAppend( listing, name );
+      if( entry == - 1 )
       {
-         activePanel->rowNo  = lastPosition % ( activePanel->maxRow -3 );
-         activePanel->rowBar = activePanel->maxRow -3;
+         return F;
       }
-      else
+   }
+   hc_listingCount( listing, entry, - 1 );
+   hc_listingFill( listing, entry, &fileInfo );
+   hc_listingCount( listing, entry, 1 );
+   listing->version++;
+   listing->edits++;
+
+   /* the entry may sort elsewhere now, e.g. a file grew or became a directory */
+   for( sortMode = 0; sortMode < SORT_MODES; sortMode++ )
+   {
+      if( sortMode != SORT_UNSORTED && listing->orders[ sortMode ] )
       {
-         activePanel->rowNo  = 0;
-         activePanel->rowBar = lastPosition;
+         hc_listingPlace( listing, sortMode, entry );
       }
    }
-   else
-   {
-      char *newDir = hc_addStr( selectedPanel->currentDir, selectedPanel->dirList[ i ].name, PS, NULL );
-      selectedPanel->rowBar = 0;
-      selectedPanel->rowNo  = 0;
 
-      hc_updateFetchList( selectedPanel, newDir );
-      free( newDir );
-   }
+   return T;
 }
+#endif
 
-static const char *hc_dirLastName( const char *path )
+/* -------------------------------------------------------------------------
+Worker pool
+------------------------------------------------------------------------- */
+static void hc_poolInit( void )
 {
-   static char result[ PATH_MAX ];
-   int pathLength;
+   memset( &workerPool, 0, sizeof( WorkerPool ) );
 
-   if( path == NULL || ( pathLength = strlen( path ) ) == 0 )
-   {
-      result[ 0 ] = '\0';
-      return result;
-   }
+   workerPool.runMutex = SDL_CreateMutex();
+   workerPool.mutex    = SDL_CreateMutex();
+   workerPool.wake     = SDL_CreateCond();
+   workerPool.done     = SDL_CreateCond();
+}
 
-   char separator = PS[ 0 ];
+static void hc_poolShutdown( void )
+{
+   int i;
 
-   if( path[ pathLength - 1 ] == separator )
+   if( !workerPool.mutex )
    {
-      pathLength--;
+      return;
    }
 
-   for( int i = pathLength - 1; i >= 0; i-- )
+   SDL_LockMutex( workerPool.mutex );
+   workerPool.quit = T;
+   SDL_CondBroadcast( workerPool.wake );
+   SDL_UnlockMutex( workerPool.mutex );
+
+   for( i = 0; i < workerPool.threadCount; i++ )
    {
-      if( path[ i ] == separator )
-      {
-         int length = pathLength - i - 1;
-         strncpy( result, path + i + 1, length );
-         result[ length ] = '\0';
-         return result;
-      }
+      SDL_WaitThread( workerPool.threads[ i ], NULL );
    }
 
-   strncpy( result, path, pathLength );
-   result[ pathLength ] = '\0';
-
-   return result;
+   SDL_DestroyCond( workerPool.done );
+   SDL_DestroyCond( workerPool.wake );
+   SDL_DestroyMutex( workerPool.mutex );
+   SDL_DestroyMutex( workerPool.runMutex );
+   memset( &workerPool, 0, sizeof( WorkerPool ) );
 }
 
-static const char *hc_dirDeleteLastPath( const char *path )
+/* Runs job( arg ) on `workers` threads at once and returns when all of them are done.
+   Threads are started on first use and kept; without hc_poolInit the job runs on the caller only.
+   A caller never waits for the job of another one: while the pool is busy, say with the stats
+   of a loader on a slow mount, the job runs on the caller only, so the UI thread never blocks. */
+static void hc_poolRun( int workers, void ( *job )( void *arg ), void *arg )
 {
-   static char result[ PATH_MAX ];
-   char *lastPath;
+   int helpers;
 
-   strncpy( result, path, sizeof( result ) - 1 );
-   result[ sizeof( result ) - 1 ] = '\0';
+   if( workers <= 1 || !workerPool.mutex || SDL_TryLockMutex( workerPool.runMutex ) != 0 )
+   {
+      job( arg );
+      return;
+   }
 
-   char separator = PS[ 0 ];
+   SDL_LockMutex( workerPool.mutex );
 
-   lastPath = strrchr( result, separator );
-   if( lastPath )
+   helpers = NK_MIN( workers, POOL_MAX_THREADS ) - 1;
+   while( workerPool.threadCount < helpers )
    {
-      char *secondLastPath = NULL;
-      *lastPath = '\0';
-      secondLastPath = strrchr( result, separator );
-
-      if( secondLastPath )
+      SDL_Thread *thread = SDL_CreateThread( hc_poolWorker, "hc_worker", NULL );
+      if( !thread )
       {
-         *lastPath = separator;
-         *( secondLastPath + 1 ) = '\0';
-      }
-      else
-      {
-         *lastPath = separator;
+         break;
       }
+      workerPool.threads[ workerPool.threadCount++ ] = thread;
    }
+   helpers = NK_MIN( helpers, workerPool.threadCount );
 
-   return result;
-}
+   workerPool.job     = job;
+   workerPool.arg     = arg;
+   workerPool.pending = helpers;
+   workerPool.running = helpers;
+   SDL_CondBroadcast( workerPool.wake );
+   SDL_UnlockMutex( workerPool.mutex );
 
-static void hc_updateFetchList( HC *selectedPanel, const char *newDir )
-{
-   strncpy( selectedPanel->currentDir, newDir, sizeof( selectedPanel->currentDir ) - 1 );
-   selectedPanel->currentDir[ sizeof( selectedPanel->currentDir ) - 1 ] = '\0';
-   hc_fetchList( selectedPanel, newDir );
+   job( arg );
+
+   SDL_LockMutex( workerPool.mutex );
+   while( workerPool.running > 0 )
+   {
+      SDL_CondWait( workerPool.done, workerPool.mutex );
+   }
+   SDL_UnlockMutex( workerPool.mutex );
+   SDL_UnlockMutex( workerPool.runMutex );
 }
 
-static int hc_dirIndexName( HC *selectedPanel, const char *tmpDir )
+static int hc_poolWorker( void *data )
 {
-   for( int i = 0; i < selectedPanel->itemCount; i++ )
+   NK_UNUSED( data );
+
+   SDL_LockMutex( workerPool.mutex );
+   for( ;; )
    {
-      if( strcmp( selectedPanel->dirList[ i ].name, tmpDir ) == 0 )
+      void ( *job )( void *arg );
+      void *arg;
+
+      while( workerPool.pending == 0 && !workerPool.quit )
       {
-         return i;
+         SDL_CondWait( workerPool.wake, workerPool.mutex );
+      }
+      if( workerPool.quit )
+      {
+         break;
+      }
+
+      --workerPool.pending;
+      job = workerPool.job;
+      arg = workerPool.arg;
+      SDL_UnlockMutex( workerPool.mutex );
+
+      job( arg );
+
+      SDL_LockMutex( workerPool.mutex );
+      if( --workerPool.running == 0 )
+      {
+         SDL_CondSignal( workerPool.done );
       }
    }
-   return - 1;
+   SDL_UnlockMutex( workerPool.mutex );
+
+   return 0;
 }
 
 /* -------------------------------------------------------------------------
@@ -1286,30 +5148,6 @@ static size_t hc_utf8Len( const char *utf8String )
    return len;
 }
 
-static size_t hc_utf8LenUpTo( const char *utf8String, const char *endPosition )
-{
-   size_t len = 0;
-   while( utf8String < endPosition && *utf8String )
-   {
-      unsigned char byte = *utf8String;
-
-      if( ( byte & 0x80 ) == 0 )         // ASCII (0xxxxxxx)
-         utf8String += 1;
-      else if( ( byte & 0xE0 ) == 0xC0 ) // (110xxxxx)
-         utf8String += 2;
-      else if( ( byte & 0xF0 ) == 0xE0 ) // (1110xxxx)
-         utf8String += 3;
-      else if( ( byte & 0xF8 ) == 0xF0 ) // (11110xxx)
-         utf8String += 4;
-      else
-         utf8String += 1;
-
-      len++;
-   }
-
-   return len;
-}
-
 static const char *hc_utf8CharPtrAt( const char *utf8String, int characterOffset )
 {
    while( characterOffset > 0 && *utf8String )
@@ -1332,7 +5170,110 @@ static const char *hc_utf8CharPtrAt( const char *utf8String, int characterOffset
    return utf8String;
 }
 
-static void hc_drawBox( struct nk_context* ctx, int x, int y, int width, int height, const char *boxString, struct nk_color bgColor, struct nk_color textColor )
+/* Code point at *utf8String, advancing it by one character the way hc_utf8Len counts them.
+   Malformed sequences decode to U+FFFD, which nuklear draws as its fallback glyph too. */
+static uint32_t hc_utf8Decode( const char **utf8String )
+{
+   const unsigned char *byte = ( const unsigned char * ) *utf8String;
+   uint32_t codepoint;
+   int length;
+   int i;
+
+   if( ( byte[ 0 ] & 0x80 ) == 0x00 )
+   {
+      *utf8String += 1;
+      return byte[ 0 ];
+   }
+   else if( ( byte[ 0 ] & 0xE0 ) == 0xC0 )
+   {
+      codepoint = byte[ 0 ] & 0x1F;
+      length = 2;
+   }
+   else if( ( byte[ 0 ] & 0xF0 ) == 0xE0 )
+   {
+      codepoint = byte[ 0 ] & 0x0F;
+      length = 3;
+   }
+   else if( ( byte[ 0 ] & 0xF8 ) == 0xF0 )
+   {
+      codepoint = byte[ 0 ] & 0x07;
+      length = 4;
+   }
+   else
+   {
+      *utf8String += 1;
+      return 0xFFFD;
+   }
+
+   for( i = 1; i < length; i++ )
+   {
+      if( ( byte[ i ] & 0xC0 ) != 0x80 )
+      {
+         /* never step over the terminating NUL of a cut sequence */
+         *utf8String += IIF( byte[ i ] == 0, i, length );
+         return 0xFFFD;
+      }
+      codepoint = ( codepoint << 6 ) | ( byte[ i ] & 0x3F );
+   }
+   *utf8String += length;
+   return codepoint;
+}
+
+/* Writes a code point as UTF-8 without a terminating NUL and returns its length in bytes */
+static int hc_utf8Encode( uint32_t codepoint, char *utf8String )
+{
+   if( codepoint < 0x80 )
+   {
+      utf8String[ 0 ] = ( char ) codepoint;
+      return 1;
+   }
+   if( codepoint < 0x800 )
+   {
+      utf8String[ 0 ] = ( char ) ( 0xC0 | ( codepoint >> 6 ) );
+      utf8String[ 1 ] = ( char ) ( 0x80 | ( codepoint & 0x3F ) );
+      return 2;
+   }
+   if( codepoint < 0x10000 )
+   {
+      utf8String[ 0 ] = ( char ) ( 0xE0 | ( codepoint >> 12 ) );
+      utf8String[ 1 ] = ( char ) ( 0x80 | ( ( codepoint >> 6 ) & 0x3F ) );
+      utf8String[ 2 ] = ( char ) ( 0x80 | ( codepoint & 0x3F ) );
+      return 3;
+   }
+   utf8String[ 0 ] = ( char ) ( 0xF0 | ( ( codepoint >> 18 ) & 0x07 ) );
+   utf8String[ 1 ] = ( char ) ( 0x80 | ( ( codepoint >> 12 ) & 0x3F ) );
+   utf8String[ 2 ] = ( char ) ( 0x80 | ( ( codepoint >> 6 ) & 0x3F ) );
+   utf8String[ 3 ] = ( char ) ( 0x80 | ( codepoint & 0x3F ) );
+   return 4;
+}
+
+/* Draws a box with an optional title centred on its top edge, the edges come from the panel's BoxCache */
+static void hc_drawBox( struct nk_context* ctx, BoxCache *cache, int x, int y, int width, int height, const char *boxString, const char *title, struct nk_color bgColor, struct nk_color textColor )
+{
+   int i;
+
+   if( width < 2 || height < 2 || !hc_boxBuild( cache, width, boxString ) )
+   {
+      return;
+   }
+
+   hc_drawText( ctx, x, y, cache->top, bgColor, textColor );
+   hc_drawText( ctx, x, y + height - 1, cache->bottom, bgColor, textColor );
+   for( i = 1; i < height - 1; i++ )
+   {
+      hc_gridPut( x, y + i, cache->vertical, bgColor, textColor );              /* left edge */
+      hc_gridPut( x + width - 1, y + i, cache->vertical, bgColor, textColor );  /* right edge */
+   }
+
+   /* Title centred on the top edge */
+   if( title && *title && ( int ) hc_utf8Len( title ) < width - 2 )
+   {
+      hc_drawText( ctx, x + ( width - ( int ) hc_utf8Len( title ) ) / 2, y, title, bgColor, textColor );
+   }
+}
+
+/* Rebuilds the cached edges when the box changed size or style since the last frame */
+static nk_bool hc_boxBuild( BoxCache *cache, int width, const char *boxString )
 {
    /* Buffers for individual UTF-8 box-drawing characters (maximum 4 bytes + 1 for '\0') */
    char topLeft[ 5 ]     = { 0 };
@@ -1341,9 +5282,20 @@ static void hc_drawBox( struct nk_context* ctx, int x, int y, int width, int hei
    char vertical[ 5 ]    = { 0 };
    char bottomRight[ 5 ] = { 0 };
    char bottomLeft[ 5 ]  = { 0 };
+   const char *verticalString = vertical;
+   size_t horizontalLength;
+   size_t topLength;
+   size_t bottomLength;
+   size_t index = 0;
+   size_t length;
+   int i;
+
+   if( cache->boxString == boxString && cache->width == width )
+   {
+      return T;
+   }
 
    /* Extract each UTF-8 character from boxString*/
-   size_t index = 0;
    hc_utf8CharExtract( boxString, topLeft, &index );
    hc_utf8CharExtract( boxString, horizontal, &index );
    hc_utf8CharExtract( boxString, topRight, &index );
@@ -1351,275 +5303,361 @@ static void hc_drawBox( struct nk_context* ctx, int x, int y, int width, int hei
    hc_utf8CharExtract( boxString, bottomRight, &index );
    hc_utf8CharExtract( boxString, bottomLeft, &index );
 
-   hc_drawText( ctx, x, y, topLeft, bgColor, textColor );                  /* top-left corner */
-   hc_drawText( ctx, x, y + height - 1, bottomLeft, bgColor, textColor );  /* bottom-left corner */
-
-   for( int i = 1; i < width - 1; i++ )
+   horizontalLength = strlen( horizontal );
+   length = NK_MAX( strlen( topLeft ) + strlen( topRight ), strlen( bottomLeft ) + strlen( bottomRight ) ) + horizontalLength * ( width - 2 ) + 1;
+   if( cache->capacity < length )
    {
-      hc_drawText( ctx, x + i, y, horizontal, bgColor, textColor );               /* top edge */
-      hc_drawText( ctx, x + i, y + height - 1, horizontal, bgColor, textColor );  /* bottom edge */
+      char *top    = realloc( cache->top, length );
+      char *bottom = top ? realloc( cache->bottom, length ) : NULL;
+
+      if( top )
+      {
+         cache->top = top;
+      }
+      if( !bottom )
+      {
+         fprintf( stderr, "Memory allocation error.\n" );
+         cache->boxString = NULL;
+         return F;
+      }
+      cache->bottom   = bottom;
+      cache->capacity = length;
    }
 
-   for( int i = 1; i < height - 1; i++ )
+   topLength    = strlen( topLeft );
+   bottomLength = strlen( bottomLeft );
+   memcpy( cache->top, topLeft, topLength );
+   memcpy( cache->bottom, bottomLeft, bottomLength );
+   for( i = 1; i < width - 1; i++ )
    {
-      hc_drawText( ctx, x, y + i, vertical, bgColor, textColor );              /* left edge */
-      hc_drawText( ctx, x + width - 1, y + i, vertical, bgColor, textColor );  /* right edge */
+      memcpy( cache->top + topLength, horizontal, horizontalLength );
+      memcpy( cache->bottom + bottomLength, horizontal, horizontalLength );
+      topLength    += horizontalLength;
+      bottomLength += horizontalLength;
    }
+   strcpy( cache->top + topLength, topRight );
+   strcpy( cache->bottom + bottomLength, bottomRight );
 
-   hc_drawText( ctx, x + width - 1, y, topRight, bgColor, textColor );                  /* top-right corner */
-   hc_drawText( ctx, x + width - 1, y + height - 1, bottomRight, bgColor, textColor );  /* bottom-right corner */
+   cache->vertical  = hc_utf8Decode( &verticalString );
+   cache->boxString = boxString;
+   cache->width     = width;
+   return T;
 }
 
-/* -------------------------------------------------------------------------
-char *hc_addStr( const char *firstString, ... )
-Adds the following strings in sequence.
-------------------------------------------------------------------------- */
-static char *hc_addStr( const char *firstString, ... )
+/* Lays the grid out over the window and blanks every cell for the frame about to be drawn.
+   A new window size or font cell, or a target that had to be made again, draws all cells. */
+static void hc_gridBegin( struct nk_context *ctx, SDL_Renderer *renderer )
 {
-   if( !firstString || *firstString == '\0' )
+   CellGrid *grid = &cellGrid;
+   Cell blank;
+   int cols = 0, rows = 0;
+   int width, height;
+   int i;
+
+   if( SDL_GetRendererOutputSize( renderer, &width, &height ) != 0 )
    {
-      return hc_strdup( "" );
+      width = height = 0;
    }
-
-   size_t totalLength = 0;
-   va_list args;
-
-   va_start( args, firstString );
-   const char *string = firstString;
-   while( string )
+   if( width != grid->width || height != grid->height )
    {
-      totalLength += strlen( string );
-      string = va_arg( args, const char * );
+      if( grid->target )
+      {
+         SDL_DestroyTexture( grid->target );
+      }
+      grid->target = IIF( width > 0 && height > 0, SDL_CreateTexture( renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height ), NULL );
+      if( grid->target )
+      {
+         /* copied over the whole window as it is */
+         SDL_SetTextureBlendMode( grid->target, SDL_BLENDMODE_NONE );
+      }
+      grid->width  = width;
+      grid->height = height;
+      grid->full   = T;
    }
-   va_end( args );
 
-   char *result = ( char * ) malloc( totalLength + 1 );
-   if( !result )
+   if( ctx->style.font )
    {
-      return NULL;
+      struct nk_rect origin = hc_cellRect( ctx, 0, 0, 1, 1 );
+
+      cols = hc_maxCol( ctx );
+      rows = hc_maxRow( ctx );
+      if( memcmp( &origin, &grid->origin, sizeof( struct nk_rect ) ) != 0 )
+      {
+         grid->origin = origin;
+         grid->full   = T;
+      }
    }
+   if( cols != grid->cols || rows != grid->rows )
+   {
+      Cell *cells = realloc( grid->cells, sizeof( Cell ) * NK_MAX( cols * rows, 1 ) );
+      Cell *shown = cells ? realloc( grid->shown, sizeof( Cell ) * NK_MAX( cols * rows, 1 ) ) : NULL;
 
-   result[ 0 ] = '\0';
+      if( cells )
+      {
+         grid->cells = cells;
+      }
+      if( shown )
+      {
+         grid->shown = shown;
+      }
+      else
+      {
+         fprintf( stderr, "Memory allocation error.\n" );
+         cols = rows = 0;
+      }
+      grid->cols = cols;
+      grid->rows = rows;
+      grid->full = T;
+   }
 
-   va_start( args, firstString );
-   string = firstString;
-   while( string )
+   blank.codepoint = ' ';
+   blank.fg        = BLACK;
+   blank.bg        = WHITE;
+   for( i = 0; i < grid->cols * grid->rows; i++ )
    {
-      strcat( result, string );
-      string = va_arg( args, const char * );
+      grid->cells[ i ] = blank;
    }
-   va_end( args );
-
-   return result;
 }
 
-/* -------------------------------------------------------------------------
-int hc_at( const char *search, const char *string )
-Return the position of a substring within a character string.
-------------------------------------------------------------------------- */
-static int hc_at( const char *search, const char *string )
+static void hc_gridPut( int col, int row, uint32_t codepoint, struct nk_color bgColor, struct nk_color textColor )
 {
-   if( !search || !*search || !string || !*string )
-   {
-      return 0;
-   }
+   Cell *cell;
 
-   char *occurrence = strstr( string, search );
-   if( !occurrence )
+   if( col < 0 || row < 0 || col >= cellGrid.cols || row >= cellGrid.rows )
    {
-      return 0;
+      return;
    }
-
-   int utf8Position = hc_utf8LenUpTo( string, occurrence );
-
-   return utf8Position;
+   cell = &cellGrid.cells[ row * cellGrid.cols + col ];
+   cell->codepoint = codepoint;
+   cell->fg        = textColor;
+   cell->bg        = bgColor;
 }
 
-/* -------------------------------------------------------------------------
-const char *hc_padR( const char *string, int length )
-Character function that pads a string of characters by a specified length.
-------------------------------------------------------------------------- */
-static char *hc_padR( const char *string, int length )
+/* Turns the cells that differ from what the target shows into draw commands, one background
+   rectangle and one text per run of changed cells of the same colours. Cells are drawn a pixel
+   above their row, background and glyphs alike, so that a cell redrawn alone covers exactly
+   what it covered before. */
+static void hc_gridFlush( struct nk_context *ctx )
 {
-   if( !string || length <= 0 )
-   {
-      return hc_strdup( "" );
-   }
-
-   int len = hc_utf8Len( string );
-   int byteLen = strlen( string );
+   CellGrid *grid = &cellGrid;
+   struct nk_command_buffer *canvas = nk_window_get_canvas( ctx );
+   const struct nk_user_font *font = ctx->style.font;
+   char *text = hc_frameAlloc( ( size_t ) grid->cols * 4 + 1 );
+   int row, col;
 
-   if( len >= length )
+   if( !canvas || !font || !text )
    {
-      return hc_subStr( string, 0, length );
+      grid->full = T;
+      return;
    }
-   else
+
+   for( row = 0; row < grid->rows; row++ )
    {
-      int padding = length - len;
+      const Cell *cells = grid->cells + row * grid->cols;
+      const Cell *shown = grid->shown + row * grid->cols;
 
-      char *result = ( char * ) malloc( byteLen + padding + 1 );
-      if( !result )
+      col = 0;
+      while( col < grid->cols )
       {
-         return NULL;
-      }
+         struct nk_rect background;
+         struct nk_rect textRect;
+         int first = col;
+         int length = 0;
+         int visible = 0;   /* bytes up to the last character that is not a space */
 
-      memcpy( result, string, byteLen );
-      memset( result + byteLen, ' ', padding );
-      result[ byteLen + padding ] = '\0';
-      return result;
+         if( !grid->full && memcmp( &cells[ col ], &shown[ col ], sizeof( Cell ) ) == 0 )
+         {
+            ++col;
+            continue;
+         }
+
+         while( col < grid->cols && ( grid->full || memcmp( &cells[ col ], &shown[ col ], sizeof( Cell ) ) != 0 ) &&
+                memcmp( &cells[ col ].fg, &cells[ first ].fg, sizeof( struct nk_color ) ) == 0 &&
+                memcmp( &cells[ col ].bg, &cells[ first ].bg, sizeof( struct nk_color ) ) == 0 )
+         {
+            length += hc_utf8Encode( cells[ col ].codepoint, text + length );
+            if( cells[ col ].codepoint != ' ' )
+            {
+               visible = length;
+            }
+            ++col;
+         }
+
+         background = hc_cellRect( ctx, first, row, col - first, 1 );
+         background.y -= 1;
+         nk_fill_rect( canvas, background, 0.0f, cells[ first ].bg );
+
+         /* wide enough for every byte, nuklear never clamps the text */
+         textRect = hc_cellRect( ctx, first, row, visible, 1 );
+         textRect.y -= 1;
+         nk_draw_text( canvas, textRect, text, visible, font, cells[ first ].bg, cells[ first ].fg );
+      }
    }
+
+   memcpy( grid->shown, grid->cells, sizeof( Cell ) * grid->cols * grid->rows );
+   grid->flushed = T;
 }
 
-/* -------------------------------------------------------------------------
-const char *hc_padL( const char *string, int length )
-Character function that pads a string of characters by a specified length.
-------------------------------------------------------------------------- */
-static char *hc_padL( const char *string, int length )
+/* Renders the frame. The nuklear commands of a flushed frame go into the target, on top of the
+   cells it kept from earlier frames, and the target is copied to the window. Frames without
+   cells, and renderers without target textures, are drawn straight to the window. */
+static void hc_gridRender( SDL_Renderer *renderer )
 {
-   if( !string || length <= 0 )
+   CellGrid *grid = &cellGrid;
+   nk_bool retained = grid->target && grid->flushed && SDL_SetRenderTarget( renderer, grid->target ) == 0;
+
+   if( grid->flushed && ( grid->full || !retained ) )
    {
-      return hc_strdup( "" );
+      SDL_SetRenderDrawColor( renderer, WHITE.r, WHITE.g, WHITE.b, 255 );
+      SDL_RenderClear( renderer );
    }
 
-   int len = hc_utf8Len( string );
-   int byteLen = strlen( string );
+   nk_sdl_render( NK_ANTI_ALIASING_ON );
 
-   if( len >= length )
+   if( retained )
    {
-      const char *byteEnd = hc_utf8CharPtrAt( string, length );
-      int truncatedBytes = byteEnd - string;
-
-      char *result = ( char * ) malloc( truncatedBytes + 1 );
-      if( !result )
-      {
-         return NULL;
-      }
-
-      memcpy( result, string, truncatedBytes );
-      result[ truncatedBytes ] = '\0';
-      return result;
+      SDL_SetRenderTarget( renderer, NULL );
+      SDL_RenderCopy( renderer, grid->target, NULL, NULL );
    }
-   else
-   {
-      int padding = length - len;
+   grid->full = !retained;
 
-      char *result = ( char * ) malloc( padding + byteLen + 1 );
-      if( !result )
-      {
-         return NULL;
-      }
+   /* a frame whose window is not shown, e.g. minimized, never flushes and must not replay this one */
+   grid->flushed = F;
+}
 
-      memset( result, ' ', padding );
-      memcpy( result + padding, string, byteLen );
-      result[ padding + byteLen ] = '\0';
-      return result;
+static void hc_gridFree( void )
+{
+   if( cellGrid.target )
+   {
+      SDL_DestroyTexture( cellGrid.target );
    }
+   free( cellGrid.cells );
+   free( cellGrid.shown );
+   memset( &cellGrid, 0, sizeof( CellGrid ) );
 }
 
 /* -------------------------------------------------------------------------
-const char *hc_left( const char *string, int count )
-Extract a substring beginning with the first character in a string.
+char *hc_addStr( const char *firstString, ... )
+Adds the following strings in sequence.
 ------------------------------------------------------------------------- */
-static char *hc_left( const char *string, int count )
+static char *hc_addStr( const char *firstString, ... )
 {
-   if( !string || count <= 0 )
+   if( !firstString || *firstString == '\0' )
    {
       return hc_strdup( "" );
    }
 
-   int len = hc_utf8Len( string );
+   size_t totalLength = 0;
+   va_list args;
 
-   if( count <= 0 )
+   va_start( args, firstString );
+   const char *string = firstString;
+   while( string )
    {
-      char *result = ( char * ) malloc( 1 );
-      if( result )
-      {
-         result[ 0 ] = '\0';
-      }
-      return result;
+      totalLength += strlen( string );
+      string = va_arg( args, const char * );
    }
+   va_end( args );
 
-   if( count >= len )
+   char *result = ( char * ) malloc( totalLength + 1 );
+   if( !result )
    {
-      return strdup( string );
+      return NULL;
    }
 
-   const char *byteEnd = hc_utf8CharPtrAt( string, count );
-   int byteCount = byteEnd - string;
+   result[ 0 ] = '\0';
 
-   char *result = ( char * ) malloc( byteCount + 1 );
-   if( result == NULL )
+   va_start( args, firstString );
+   string = firstString;
+   while( string )
    {
-      return NULL;
+      strcat( result, string );
+      string = va_arg( args, const char * );
    }
-
-   memcpy( result, string, byteCount );
-   result[ byteCount ] = '\0';
+   va_end( args );
 
    return result;
 }
 
-/* -------------------------------------------------------------------------
-char *hc_subStr( const char *string, int start, int count )
-Extract a substring from a character string
-------------------------------------------------------------------------- */
-static char *hc_subStr( const char *string, int start, int count )
+/* Room for size bytes in the frame arena, valid until the next hc_frameReset; NULL when out of memory */
+static char *hc_frameAlloc( size_t size )
 {
-   if( !string || *string == '\0' )
-   {
-      return hc_strdup( "" );
-   }
+   ArenaBlock *block = frameArena;
 
-   int nSize = hc_utf8Len( string );
-
-   if( start > nSize )
+   if( !block || block->capacity - block->used < size )
    {
-      count = 0;
-   }
+      size_t capacity = IIF( block, block->capacity * 2, FRAME_ARENA_INITIAL );
 
-   if( count > 0 )
-   {
-      if( start < 0 )
-      {
-         start = nSize + start;
-      }
-      if( start < 0 )
+      while( capacity < size )
       {
-         start = 0;
+         capacity *= 2;
       }
-      if( start + count > nSize )
+      block = malloc( sizeof( ArenaBlock ) + capacity );
+      if( !block )
       {
-         count = nSize - start;
+         fprintf( stderr, "Memory allocation error.\n" );
+         return NULL;
       }
+      block->previous = frameArena;
+      block->capacity = capacity;
+      block->used     = 0;
+      frameArena = block;
    }
-   else
+
+   block->used += size;
+   return block->data + block->used - size;
+}
+
+/* Drops every string of the last frame, keeping the largest block for the next one */
+static void hc_frameReset( void )
+{
+   if( !frameArena )
    {
-      if( start < 0 )
-      {
-         start = nSize + start;
-      }
-      if( start < 0 )
-      {
-         start = 0;
-      }
-      count = nSize - start;
+      return;
    }
+   while( frameArena->previous )
+   {
+      ArenaBlock *previous = frameArena->previous;
+
+      frameArena->previous = previous->previous;
+      free( previous );
+   }
+   frameArena->used = 0;
+}
 
-   const char *byteStart = hc_utf8CharPtrAt( string, start );
-   const char *byteEnd = hc_utf8CharPtrAt( byteStart, count );
+static void hc_frameFree( void )
+{
+   hc_frameReset();
+   free( frameArena );
+   frameArena = NULL;
+}
 
-   int byteCount = byteEnd - byteStart;
+static nk_bool hc_envBool( const char *name, nk_bool defaultValue )
+{
+   const char *value = getenv( name );
 
-   char *result = ( char * ) malloc( byteCount + 1 );
-   if( !result )
+   if( !value || !*value )
    {
-      return hc_strdup( "" );
+      return defaultValue;
    }
 
-   memcpy( result, byteStart, byteCount );
-   result[ byteCount ] = '\0';
+   return IIF( strcmp( value, "0" ) == 0 || strcmp( value, "F" ) == 0 || strcmp( value, "f" ) == 0, F, T );
+}
 
-   return result;
+/* Non negative integer from the environment, defaultValue when unset or malformed */
+static int hc_envInt( const char *name, int defaultValue )
+{
+   const char *value = getenv( name );
+   char *end;
+   long number;
+
+   if( !value || !*value )
+   {
+      return defaultValue;
+   }
+
+   number = strtol( value, &end, 10 );
+   return IIF( *end == '\0' && number >= 0 && number <= INT_MAX, ( int ) number, defaultValue );
 }
 
 static char *hc_strdup( const char *string )